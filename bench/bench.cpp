@@ -0,0 +1,344 @@
+// Microbenchmarks of the hand-off buffers between the reader, detection and draw threads
+// and of the detector engines, as JSON on stdout so runs can be compared between commits.
+// Every buffer case runs one writer against 1, 2 and 8 readers (the single reader buffers
+// only against one) and reports throughput and the writer -> reader latency. The old
+// DoubleBuffer<T> (bench/double_buffer.hpp) runs next to the SeqLock that replaced it.
+// Engines run single threaded on the synthetic input and report the time per detection frame.
+//
+//   make bench && ./dcm_bench > bench.json
+//   ./dcm_bench 2000   (ms per case, default 500)
+
+#include "../src/buffers.hpp"
+#include "../src/detector_engine.hpp"
+#include "../src/frame.hpp"
+#include "../src/input_source.hpp"
+#include "double_buffer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr int READER_COUNTS[] = {1, 2, 8};
+static constexpr int FRAME_SIZES[][2] = {{704, 576}, {1920, 1080}};
+static constexpr size_t LATENCY_SAMPLES_MAX = 1 << 20; // per reader
+static constexpr int ENGINE_FRAMES = 250;                // 10 s of synthetic input, motion comes and goes
+
+static int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct BenchResult {
+    std::string buffer;
+    std::string payload; // "frame" (width x height), "value" or "point_list" (width / height 0)
+    int width;
+    int height;
+    int readers;
+    double writes_per_s;
+    double reads_per_s;    // get/peek calls, all readers
+    double observed_per_s; // new values seen, all readers
+    int64_t p50_ns;
+    int64_t p99_ns;
+    int64_t max_ns;
+};
+
+// write(sequence) publishes a value stamped with now_ns(), read() returns the stamp of
+// what it sees (0 for nothing), a stamp different from the previous one is a new value
+static BenchResult run(const std::string& buffer, const std::string& payload, int width, int height, int readers,
+                       int ms, const std::function<void(uint64_t)>& write, const std::function<int64_t()>& read)
+{
+    std::atomic<bool> started{false};
+    std::atomic<bool> stopped{false};
+    uint64_t writes = 0;
+    std::vector<uint64_t> reads(readers, 0);
+    std::vector<uint64_t> observed(readers, 0);
+    std::vector<std::vector<int64_t>> latencies(readers);
+
+    std::thread writer([&] {
+        while (!started) { std::this_thread::yield(); }
+        while (!stopped) { write(++writes); }
+    });
+
+    std::vector<std::thread> threads;
+    for (int r = 0; r < readers; r++) {
+        threads.emplace_back([&, r] {
+            latencies[r].reserve(LATENCY_SAMPLES_MAX);
+            int64_t last = 0;
+            while (!started) { std::this_thread::yield(); }
+            while (!stopped) {
+                int64_t stamp = read();
+                reads[r]++;
+                if (stamp == 0 || stamp == last) { continue; }
+                last = stamp;
+                observed[r]++;
+                if (latencies[r].size() < LATENCY_SAMPLES_MAX) { latencies[r].push_back(now_ns() - stamp); }
+            }
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    started = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    stopped = true;
+    writer.join();
+    for (auto& thread : threads) { thread.join(); }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<int64_t> all;
+    uint64_t reads_total = 0;
+    uint64_t observed_total = 0;
+    for (int r = 0; r < readers; r++) {
+        reads_total += reads[r];
+        observed_total += observed[r];
+        all.insert(all.end(), latencies[r].begin(), latencies[r].end());
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&](double p) { return all.empty() ? 0 : all[static_cast<size_t>(p * (all.size() - 1))]; };
+
+    return {buffer, payload, width, height, readers,
+            writes / seconds, reads_total / seconds, observed_total / seconds,
+            percentile(0.50), percentile(0.99), all.empty() ? 0 : all.back()};
+}
+
+// decoded frame published by a reader, consumers peek at it (draw loop, detection)
+static BenchResult bench_frame_mailbox(int width, int height, int readers, int ms)
+{
+    FramePool pool;
+    FrameMailbox mailbox;
+    cv::Mat source(height, width, CV_8UC3, cv::Scalar(0, 0, 0));
+
+    return run("FrameMailbox", "frame", width, height, readers, ms,
+               [&](uint64_t sequence) {
+                   std::shared_ptr<Frame> frame = pool.acquire(width, height, CV_8UC3);
+                   source.copyTo(frame->mat);
+                   frame->generation = sequence;
+                   frame->published = std::chrono::steady_clock::now();
+                   mailbox.publish(frame);
+               },
+               [&]() -> int64_t {
+                   FramePtr frame = mailbox.peek();
+                   if (!frame) { return 0; }
+                   volatile uchar pixel = frame->mat.data[0]; // touch the pixels like a consumer would
+                   (void)pixel;
+                   return std::chrono::duration_cast<std::chrono::nanoseconds>(frame->published.time_since_epoch()).count();
+               });
+}
+
+// frame sized payload through a TripleBuffer, the reader borrows instead of copying
+static BenchResult bench_triple_buffer(int width, int height, int ms)
+{
+    std::vector<uchar> source(static_cast<size_t>(width) * height * 3);
+    TripleBuffer<std::vector<uchar>> buffer(source);
+
+    return run("TripleBuffer", "frame", width, height, 1, ms,
+               [&](uint64_t) {
+                   int64_t stamp = now_ns();
+                   std::memcpy(source.data(), &stamp, sizeof(stamp));
+                   buffer.update(source);
+               },
+               [&]() -> int64_t {
+                   const std::vector<uchar>& data = buffer.get();
+                   int64_t stamp;
+                   std::memcpy(&stamp, data.data(), sizeof(stamp));
+                   return stamp;
+               });
+}
+
+// motion region / mouse position sized values
+struct StampedRect {
+    int64_t stamp;
+    cv::Rect rect;
+};
+
+static BenchResult bench_seqlock(int readers, int ms)
+{
+    SeqLock<StampedRect> buffer;
+
+    return run("SeqLock", "value", 0, 0, readers, ms,
+               [&](uint64_t sequence) {
+                   int v = static_cast<int>(sequence);
+                   buffer.update({now_ns(), cv::Rect(v, v, v, v)});
+               },
+               [&]() -> int64_t { return buffer.get().stamp; });
+}
+
+// the same values through the DoubleBuffer<T> SeqLock replaced, old against new
+static BenchResult bench_double_buffer(int readers, int ms)
+{
+    DoubleBuffer<StampedRect> buffer;
+
+    return run("DoubleBuffer (old)", "value", 0, 0, readers, ms,
+               [&](uint64_t sequence) {
+                   int v = static_cast<int>(sequence);
+                   buffer.update({now_ns(), cv::Rect(v, v, v, v)});
+               },
+               [&]() -> int64_t { return buffer.get().stamp; });
+}
+
+// king chain, a point list of 8 tile indices copied on every get(), never frame sized
+static BenchResult bench_double_buffer_vec(int readers, int ms)
+{
+    DoubleBufferVec buffer({1, 2, 3, 4, 5, 6, 7, 8});
+    std::vector<int> chain = {1, 2, 3, 4, 5, 6, 7, 8};
+
+    return run("DoubleBufferVec", "point_list", 0, 0, readers, ms,
+               [&](uint64_t) {
+                   int64_t stamp = now_ns();
+                   std::memcpy(chain.data(), &stamp, sizeof(stamp)); // first two ints
+                   buffer.update(chain);
+               },
+               [&]() -> int64_t {
+                   std::vector<int> data = buffer.get();
+                   int64_t stamp;
+                   std::memcpy(&stamp, data.data(), sizeof(stamp));
+                   return stamp;
+               });
+}
+
+struct EngineResult {
+    std::string engine;
+    int width;
+    int height;
+    int tiles;
+    double ms_per_frame;
+    double foreground_per_frame; // pixels
+};
+
+// stand-in for the decoder's macroblock grid (Frame::motion): a block whose pixels changed
+// since the previous frame moved 2 px
+static void synthetic_motion_vectors(const cv::Mat& luma, const cv::Mat& previous, cv::Mat& diff, cv::Mat& grid)
+{
+    cv::Size cells((luma.cols + MOTION_VECTOR_BLOCK - 1) / MOTION_VECTOR_BLOCK, (luma.rows + MOTION_VECTOR_BLOCK - 1) / MOTION_VECTOR_BLOCK);
+    if (previous.empty()) {
+        grid = cv::Mat::zeros(cells, CV_8UC1);
+        return;
+    }
+    cv::absdiff(luma, previous, diff);
+    cv::resize(diff, grid, cells, 0, 0, cv::INTER_AREA);
+    cv::threshold(grid, grid, 8, 2 * MOTION_VECTOR_UNIT, cv::THRESH_BINARY);
+}
+
+// the channel 0 mosaic split into its 8 channel tiles like the detector does,
+// or one full HD frame like focus mode. mv is fed a synthetic macroblock grid of the
+// same scene, expanding it to pixels like the detection thread does counts towards its time.
+static EngineResult bench_engine(int engine, int width, int height)
+{
+    std::vector<cv::Rect> tiles;
+    bool mosaic = width == W_0 && height == H_0;
+    if (mosaic) {
+        for (int ch = 1; ch <= CHANNEL_COUNT; ch++) {
+            int row = (ch - 1) / 3;
+            int col = (ch - 1) % 3;
+            tiles.push_back(cv::Rect(col * W_0 / 3, row * H_0 / 3, W_0 / 3, H_0 / 3));
+        }
+    }
+    else {
+        tiles.push_back(cv::Rect(0, 0, width, height));
+    }
+
+    DetectEngineParams params;
+    params.engine = engine;
+    std::vector<std::unique_ptr<DetectorEngine>> engines;
+    for (size_t i = 0; i < tiles.size(); i++) {
+        engines.push_back(DetectorEngine::create(params));
+    }
+
+    cv::Mat bgr(height, width, CV_8UC3);
+    cv::Mat luma;
+    cv::Mat previous;
+    cv::Mat diff;
+    cv::Mat grid;
+    cv::Mat motion;
+    cv::Mat mask;
+    bool vectors = engine == DETECT_ENGINE_MV;
+    double ms = 0;
+    uint64_t foreground = 0;
+    for (int i = 0; i < ENGINE_FRAMES; i++) {
+        if (mosaic) { render_synthetic_mosaic(bgr, i); }
+        else { render_synthetic(bgr, 1, i); }
+        cv::cvtColor(bgr, luma, cv::COLOR_BGR2GRAY);
+
+        if (vectors) {
+            synthetic_motion_vectors(luma, previous, diff, grid); // the decoder's work, not timed
+            luma.copyTo(previous);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        if (vectors) { cv::resize(grid, motion, luma.size(), 0, 0, cv::INTER_NEAREST); }
+        const cv::Mat& input = vectors ? motion : luma;
+        for (size_t t = 0; t < tiles.size(); t++) {
+            foreground += engines[t]->apply(input(tiles[t]), mask);
+        }
+        ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    return {DetectorEngine::name(engine), width, height, static_cast<int>(tiles.size()),
+            ms / ENGINE_FRAMES, static_cast<double>(foreground) / ENGINE_FRAMES};
+}
+
+static void print_json(const std::vector<BenchResult>& results, const std::vector<EngineResult>& engines, int ms)
+{
+    std::cout << "{\n";
+    std::cout << "  \"ms_per_case\": " << ms << ",\n";
+    std::cout << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+    std::cout << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        std::cout << "    {\"buffer\": \"" << r.buffer << "\", \"payload\": \"" << r.payload
+                  << "\", \"width\": " << r.width << ", \"height\": " << r.height
+                  << ", \"readers\": " << r.readers
+                  << ", \"writes_per_s\": " << static_cast<uint64_t>(r.writes_per_s)
+                  << ", \"reads_per_s\": " << static_cast<uint64_t>(r.reads_per_s)
+                  << ", \"observed_per_s\": " << static_cast<uint64_t>(r.observed_per_s)
+                  << ", \"latency_ns\": {\"p50\": " << r.p50_ns << ", \"p99\": " << r.p99_ns << ", \"max\": " << r.max_ns << "}}"
+                  << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    std::cout << "  ],\n";
+    std::cout << "  \"engines\": [\n";
+    for (size_t i = 0; i < engines.size(); i++) {
+        const EngineResult& e = engines[i];
+        std::cout << "    {\"engine\": \"" << e.engine << "\", \"width\": " << e.width << ", \"height\": " << e.height
+                  << ", \"tiles\": " << e.tiles << ", \"frames\": " << ENGINE_FRAMES
+                  << ", \"ms_per_frame\": " << e.ms_per_frame
+                  << ", \"foreground_per_frame\": " << static_cast<uint64_t>(e.foreground_per_frame) << "}"
+                  << (i + 1 < engines.size() ? "," : "") << "\n";
+    }
+    std::cout << "  ]\n";
+    std::cout << "}" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    int ms = argc > 1 ? std::max(1, std::stoi(argv[1])) : 500;
+
+    std::vector<BenchResult> results;
+    for (const auto& size : FRAME_SIZES) {
+        for (int readers : READER_COUNTS) {
+            results.push_back(bench_frame_mailbox(size[0], size[1], readers, ms));
+        }
+        results.push_back(bench_triple_buffer(size[0], size[1], ms)); // one reader by design
+    }
+    for (int readers : READER_COUNTS) {
+        results.push_back(bench_seqlock(readers, ms));
+        results.push_back(bench_double_buffer(readers, ms));
+        results.push_back(bench_double_buffer_vec(readers, ms));
+    }
+
+    // one thread, the time per frame is the engine's CPU cost
+    std::vector<EngineResult> engines;
+    int threads = cv::getNumThreads();
+    cv::setNumThreads(1);
+    for (const auto& size : FRAME_SIZES) {
+        for (int engine = 0; engine < DETECT_ENGINE_COUNT; engine++) {
+            engines.push_back(bench_engine(engine, size[0], size[1]));
+        }
+    }
+    cv::setNumThreads(threads);
+
+    print_json(results, engines, ms);
+    return 0;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// DoubleBuffer<T> as src/buffers.hpp had it before TripleBuffer and SeqLock replaced it,
+// kept so `make bench` can put the old and the new numbers side by side.
+// The writer may overwrite the inactive slot while a reader is still copying it,
+// only bench it with trivially copyable values (a torn value, never a freed buffer).
+
+#include <array>
+#include <atomic>
+
+template <typename T>
+class DoubleBuffer {
+  private:
+    std::array<T, 2> buffers;
+    std::atomic<int> activeBuffer{0}; // read buffer
+
+  public:
+    DoubleBuffer() = default;
+
+    explicit DoubleBuffer(const T& initialData)
+    {
+        buffers[0] = cloneData(initialData);
+        buffers[1] = cloneData(initialData);
+    }
+
+    void update(const T& data)
+    {
+        int writeIndex = 1 - activeBuffer.load(std::memory_order_acquire);
+        buffers[writeIndex] = cloneData(data);
+        activeBuffer.store(writeIndex, std::memory_order_release);
+    }
+
+    T get() const
+    {
+        int readIndex = activeBuffer.load(std::memory_order_acquire);
+        return cloneData(buffers[readIndex]);
+    }
+
+  private:
+    T cloneData(const T& data) const
+    {
+        return T(data);
+    }
+};
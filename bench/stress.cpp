@@ -0,0 +1,146 @@
+// Stress test of the hand-off buffers under ThreadSanitizer: one writer hammers each
+// buffer while readers check every value they see is whole and never goes backwards.
+// Exits non-zero on a torn or stale value, ThreadSanitizer fails the run on a race.
+//
+//   make tsan
+//   ./dcm_stress 5000   (ms per buffer, default 1000)
+
+#include "../src/buffers.hpp"
+#include "../src/frame.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr int READERS = 4;
+static constexpr int FRAME_SIDE = 64; // small frames so the readers check every pixel
+
+static std::atomic<uint64_t> g_errors{0};
+
+static void fail(const std::string& buffer, const std::string& what)
+{
+    if (g_errors++ < 10) { std::cerr << buffer << ": " << what << std::endl; }
+}
+
+// runs the writer and the readers until `ms` passed, returns the writes made
+static uint64_t hammer(int ms, int readers, const std::function<void(uint64_t)>& write, const std::function<void()>& read)
+{
+    std::atomic<bool> stopped{false};
+    uint64_t writes = 0;
+
+    std::thread writer([&] {
+        while (!stopped) { write(++writes); }
+    });
+    std::vector<std::thread> threads;
+    for (int r = 0; r < readers; r++) {
+        threads.emplace_back([&] {
+            while (!stopped) { read(); }
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    stopped = true;
+    writer.join();
+    for (auto& thread : threads) { thread.join(); }
+    return writes;
+}
+
+// one reader by design, the value is a vector of varying length filled with its sequence
+static void stress_triple_buffer(int ms)
+{
+    TripleBuffer<std::vector<uint64_t>> buffer;
+    std::vector<uint64_t> value;
+    uint64_t last = 0;
+
+    uint64_t writes = hammer(ms, 1,
+                             [&](uint64_t sequence) {
+                                 value.assign(1 + sequence % 257, sequence);
+                                 buffer.update(value);
+                             },
+                             [&] {
+                                 const std::vector<uint64_t>& data = buffer.get();
+                                 if (data.empty()) { return; } // nothing published yet
+                                 if (data.size() != 1 + data[0] % 257) { fail("TripleBuffer", "wrong length"); }
+                                 if (std::any_of(data.begin(), data.end(), [&](uint64_t v) { return v != data[0]; })) { fail("TripleBuffer", "torn value"); }
+                                 if (data[0] < last) { fail("TripleBuffer", "went backwards"); }
+                                 last = data[0];
+                             });
+    std::cout << "TripleBuffer: " << writes << " writes" << std::endl;
+}
+
+static void stress_seqlock(int ms)
+{
+    struct Value {
+        uint64_t a;
+        uint64_t b;
+        uint64_t c;
+    };
+    SeqLock<Value> buffer;
+
+    uint64_t writes = hammer(ms, READERS,
+                             [&](uint64_t sequence) { buffer.update({sequence, sequence, sequence}); },
+                             [&] {
+                                 thread_local uint64_t last = 0;
+                                 Value value = buffer.get();
+                                 if (value.a != value.b || value.b != value.c) { fail("SeqLock", "torn value"); }
+                                 if (value.a < last) { fail("SeqLock", "went backwards"); }
+                                 last = value.a;
+                             });
+    std::cout << "SeqLock: " << writes << " writes" << std::endl;
+}
+
+// pooled frames filled with their generation, readers peek and take like the draw and detection threads
+static void stress_frame_mailbox(int ms)
+{
+    FramePool pool;
+    FrameMailbox mailbox;
+
+    auto check = [](const FramePtr& frame) {
+        uchar expected = static_cast<uchar>(frame->generation);
+        if (cv::countNonZero(frame->mat != expected) != 0) { fail("FrameMailbox", "pixels changed while held"); }
+    };
+
+    uint64_t writes = hammer(ms, READERS,
+                             [&](uint64_t sequence) {
+                                 std::shared_ptr<Frame> frame = pool.acquire(FRAME_SIDE, FRAME_SIDE, CV_8UC1);
+                                 frame->mat.setTo(static_cast<uchar>(sequence));
+                                 frame->generation = sequence;
+                                 mailbox.publish(frame);
+                             },
+                             [&] {
+                                 thread_local uint64_t last_peek = 0;
+                                 thread_local uint64_t last_take = 0;
+                                 if (FramePtr frame = mailbox.peek()) {
+                                     check(frame);
+                                     if (frame->generation < last_peek) { fail("FrameMailbox", "peek went backwards"); }
+                                     last_peek = frame->generation;
+                                 }
+                                 if (FramePtr frame = mailbox.take()) {
+                                     check(frame);
+                                     if (frame->generation <= last_take) { fail("FrameMailbox", "take returned a frame twice"); }
+                                     last_take = frame->generation;
+                                 }
+                             });
+    std::cout << "FrameMailbox: " << writes << " writes, " << pool.size() << " pooled frames, "
+              << mailbox.consumed() << " taken" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    int ms = argc > 1 ? std::max(1, std::stoi(argv[1])) : 1000;
+
+    stress_triple_buffer(ms);
+    stress_seqlock(ms);
+    stress_frame_mailbox(ms);
+
+    if (g_errors) {
+        std::cerr << g_errors << " errors" << std::endl;
+        return 1;
+    }
+    std::cout << "ok" << std::endl;
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include "debug.hpp"
+
+#ifdef DEBUG_ALLOC
+#include <cstdlib>
+#include <new>
+#include <opencv2/core.hpp>
+
+// every heap allocation of the process goes through here, counted per thread.
+// cv::Mat pixel buffers bypass operator new (cv::fastMalloc), MatAllocatorCounter counts them
+static thread_local uint64_t t_allocations = 0;
+
+uint64_t alloc_count()
+{
+    return t_allocations;
+}
+
+static void* counted_alloc(std::size_t size)
+{
+    t_allocations++;
+    if (void* ptr = std::malloc(size ? size : 1)) { return ptr; }
+    throw std::bad_alloc();
+}
+
+static void* counted_alloc_aligned(std::size_t size, std::align_val_t align)
+{
+    t_allocations++;
+    std::size_t alignment = static_cast<std::size_t>(align);
+    if (void* ptr = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)) { return ptr; }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size) { return counted_alloc(size); }
+void* operator new[](std::size_t size) { return counted_alloc(size); }
+void* operator new(std::size_t size, std::align_val_t align) { return counted_alloc_aligned(size, align); }
+void* operator new[](std::size_t size, std::align_val_t align) { return counted_alloc_aligned(size, align); }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+
+// OpenCV's own allocator underneath, a new buffer (not user data) counts on the calling thread.
+// Its UMatData is a counted operator new as well, a new cv::Mat is 2 allocations
+class MatAllocatorCounter : public cv::MatAllocator {
+  public:
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, cv::AccessFlag flags,
+                           cv::UMatUsageFlags usage) const override
+    {
+        if (!data) { t_allocations++; }
+        return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usage);
+    }
+
+    bool allocate(cv::UMatData* data, cv::AccessFlag flags, cv::UMatUsageFlags usage) const override
+    {
+        return cv::Mat::getStdAllocator()->allocate(data, flags, usage);
+    }
+
+    void deallocate(cv::UMatData* data) const override
+    {
+        cv::Mat::getStdAllocator()->deallocate(data);
+    }
+};
+
+void install_mat_alloc_counter()
+{
+    static MatAllocatorCounter counter;
+    cv::Mat::setDefaultAllocator(&counter);
+}
+#endif
@@ -8,17 +8,42 @@ std::unique_ptr<argparse::ArgumentParser> parse_args() {
 
     auto& options_required = program->add_group("Required Options");
     options_required.add_argument("-i", "--ip")
-        .help("ip to connect to")
+        .help("ip to connect to (required with dahua input)")
         .metavar("ip")
-        .required();
+        .default_value("");
     options_required.add_argument("-u", "--username")
-        .help("account username")
+        .help("account username (required with dahua input)")
         .metavar("username")
-        .required();
+        .default_value("");
     options_required.add_argument("-p", "--password")
-        .help("account password")
+        .help("account password (required with dahua input)")
         .metavar("password")
-        .required();
+        .default_value("");
+
+    auto& options_input = program->add_group("Input Options");
+    options_input.add_argument("-in", "--input")
+        .help("where to read channels from: dahua, synthetic, file path or url ({ch} is replaced with the channel number, 0 = all channels view) (e.g.: \"videos/ch{ch}.mp4\")")
+        .metavar("dahua/synthetic/<file>/<url>")
+        .default_value(INPUT);
+    options_input.add_argument("-inr", "--input_realtime")
+        .help("play files and synthetic input at real-time speed (0 = as fast as possible)")
+        .metavar("0/1")
+        .default_value(INPUT_REALTIME)
+        .scan<'i', int>();
+    options_input.add_argument("-dw", "--decode_workers")
+        .help("threads decoding all channels, readers only receive packets (0 = one per cpu thread)")
+        .metavar("NUMBER")
+        .default_value(DECODE_WORKERS)
+        .scan<'i', int>();
+    options_input.add_argument("-dt", "--decode_threads")
+        .help("codec thread budget shared by all channels, the displayed and detected channels get most of it (0 = one per cpu thread)")
+        .metavar("NUMBER")
+        .default_value(DECODE_THREADS)
+        .scan<'i', int>();
+    options_input.add_argument("-sc", "--stream_cache")
+        .help("file to keep each stream's codec parameters in, later starts skip stream probing (empty = off)")
+        .metavar("streams.cache")
+        .default_value(STREAM_CACHE);
 
     auto& options_window = program->add_group("Window Options");
     options_window.add_argument("-ww", "--width")
@@ -93,6 +118,35 @@ std::unique_ptr<argparse::ArgumentParser> parse_args() {
         .metavar("0/1")
         .default_value(ENABLE_MOTION_ZOOM_LARGEST)
         .scan<'i', int>();
+    options_motion.add_argument("-de", "--detect_engine")
+        .help("background model: knn, mog2, cnt (bgsegm), diff (running average), ewma (fixed point running average, SIMD) or mv (the H.264 encoder's motion vectors, no pixel analysis, software decoding)")
+        .metavar("knn/mog2/cnt/diff/ewma/mv")
+        .default_value(DETECT_ENGINE);
+    options_motion.add_argument("-deh", "--detect_history")
+        .help("frames the background adapts over (knn/mog2/diff: history, ewma: history rounded to a power of 2, cnt: min pixel stability, mv: frames in a row a block must move 2, 0 = engine default)")
+        .metavar("NUMBER")
+        .default_value(DETECT_HISTORY)
+        .scan<'i', int>();
+    options_motion.add_argument("-det", "--detect_threshold")
+        .help("foreground threshold (knn: squared distance 400, mog2: variance 32, diff/ewma: luma difference 25, mv: vector length in quarter pixels 4, cnt: unused, 0 = engine default)")
+        .metavar("NUMBER")
+        .default_value(DETECT_THRESHOLD)
+        .scan<'g', double>();
+    options_motion.add_argument("-dif", "--detect_idle_fps")
+        .help("detection rate once no foreground was seen for -dis seconds, the first foreground pixels bring back every frame (0 = always every frame)")
+        .metavar("NUMBER")
+        .default_value(DETECT_IDLE_FPS)
+        .scan<'i', int>();
+    options_motion.add_argument("-dis", "--detect_idle_s")
+        .help("seconds without foreground before detecting at the idle rate")
+        .metavar("SECONDS")
+        .default_value(DETECT_IDLE_S)
+        .scan<'i', int>();
+    options_motion.add_argument("-db", "--detect_blobs")
+        .help("find motion with connected components stats (one pass, no point lists, -a is then the pixel count) instead of contours, outlines are only traced for -eir")
+        .metavar("0/1")
+        .default_value(DETECT_BLOBS)
+        .scan<'i', int>();
 
     auto& options_sleep = program->add_group("Sleep Options");
     options_sleep.add_argument("-smd", "--sleep_ms_draw")
@@ -100,11 +154,6 @@ std::unique_ptr<argparse::ArgumentParser> parse_args() {
         .metavar("NUMBER")
         .default_value(-1)
         .scan<'i', int>();
-    options_sleep.add_argument("-smm", "--sleep_ms_motion")
-        .help("how long to sleep at the end of the motion detection loop (-1 == auto detect fps and use that)")
-        .metavar("NUMBER")
-        .default_value(-1)
-        .scan<'i', int>();
 
     auto& options_tour = program->add_group("Tour Options");
     options_tour.add_argument("-et", "--enable_tour")
@@ -124,6 +173,11 @@ std::unique_ptr<argparse::ArgumentParser> parse_args() {
         .metavar("0/1")
         .default_value(ENABLE_INFO)
         .scan<'i', int>();
+    options_info.add_argument("-lr", "--latency_report")
+        .help("print per channel latency percentiles (decode, convert, detect, display, total) every X seconds (0 = off)")
+        .metavar("SECONDS")
+        .default_value(LATENCY_REPORT_S)
+        .scan<'i', int>();
     options_info.add_argument("-eil", "--enable_info_line")
         .help("enable drawing line info (motion, linger, tour, ...)")
         .metavar("0/1")
@@ -181,6 +235,19 @@ std::unique_ptr<argparse::ArgumentParser> parse_args() {
         .help("specify alarm pixels inside file (seperated by new line) (e.g.: \"<x>x<y>\\n<x>x<y>...\")")
         .metavar("alarm.txt")
         .default_value(ALARM_PIXELS_FILE);
+    options_alarm.add_argument("-az", "--alarm_zones")
+        .help("specify alarm zones (polygons, points seperated by space, zones seperated by comma, optional minimum foreground pixels before a colon) (e.g.: \"20:<x>x<y> ...,<x>x<y> ...\")")
+        .metavar("\"[min:]<x>x<y> ...,<x>x<y> ...\"")
+        .default_value(ALARM_ZONES);
+    options_alarm.add_argument("-azf", "--alarm_zones_file")
+        .help("specify alarm zones inside file (one zone per line, same format as -az)")
+        .metavar("zones.txt")
+        .default_value(ALARM_ZONES_FILE);
+    options_alarm.add_argument("-azm", "--alarm_zone_min")
+        .help("foreground pixels inside a zone (or the alarm pixels) that trigger the alarm, unless the zone sets its own")
+        .metavar("NUMBER")
+        .default_value(ALARM_ZONE_MIN)
+        .scan<'i', int>();
 
 
     auto& options_focus = program->add_group("Focus Channel Options");
@@ -198,6 +265,15 @@ std::unique_ptr<argparse::ArgumentParser> parse_args() {
         .metavar("0/1")
         .default_value(FOCUS_CHANNEL_SOUND)
         .scan<'i', int>();
+    options_focus.add_argument("-ft", "--focus_targets")
+        .help("focus on several channels/areas at once, each detected on its own (targets seperated by comma, area and sound optional) (e.g.: \"3:<x>x<y> <w>x<h>:1,6\")")
+        .metavar("\"<ch>[:<x>x<y> <w>x<h>[:0/1]],...\"")
+        .default_value(FOCUS_TARGETS);
+    options_focus.add_argument("-fdw", "--focus_detect_width")
+        .help("detect at most at this width (0 = native resolution of the channel/area, never more than the window)")
+        .metavar("NUMBER")
+        .default_value(FOCUS_DETECT_WIDTH)
+        .scan<'i', int>();
 
     auto& options_special = program->add_group("Special Options");
     options_special.add_argument("-lc", "--low_cpu")
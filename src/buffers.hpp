@@ -2,75 +2,10 @@
 
 #include <array>
 #include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <opencv2/opencv.hpp>
-#include <optional>
-
-template <typename T, size_t Size>
-class LockFreeRingBuffer {
-  private:
-    std::array<T, Size> m_buffer;
-    std::atomic<size_t> m_head{0};
-    std::atomic<size_t> m_tail{0};
-
-  public:
-    bool push(T item)
-    {
-        size_t current_head = m_head.load(std::memory_order_relaxed);
-        size_t next_head = (current_head + 1) % Size;
-
-        if (next_head == m_tail.load(std::memory_order_acquire))
-            return false; // Buffer full
-
-        m_buffer[current_head] = std::move(item);
-        m_head.store(next_head, std::memory_order_release);
-        return true;
-    }
-
-    std::optional<T> pop()
-    {
-        size_t current_tail = m_tail.load(std::memory_order_relaxed);
-        size_t current_head = m_head.load(std::memory_order_acquire);
-
-        if (current_head == current_tail)
-            return std::nullopt; // Buffer empty
-
-        T item = std::move(m_buffer[current_tail]);
-        m_tail.store((current_tail + 1) % Size, std::memory_order_release);
-        return item;
-    }
-};
-
-// Ensure LockFreeRingBuffer works with cv::UMat
-// If it uses std::optional or similar, cv::UMat should work as-is since it's copyable
-
-class DoubleBufferMat {
-  private:
-    cv::Mat buffers[2];
-    std::atomic<int> activeBuffer{0}; // read buffer
-
-  public:
-    DoubleBufferMat() {}
-    DoubleBufferMat(cv::Mat initialData)
-    {
-        buffers[0] = initialData.clone();
-        buffers[1] = initialData.clone();
-    }
-
-    // Writer updates the non-active buffer and then swaps
-    void update(const cv::Mat& frame)
-    {
-        int writeIndex = 1 - activeBuffer.load(std::memory_order_acquire);
-        buffers[writeIndex] = frame.clone();
-        activeBuffer.store(writeIndex, std::memory_order_release);
-    }
-
-    // Reader reads from the active buffer
-    cv::Mat get() const
-    {
-        int readIndex = activeBuffer.load(std::memory_order_acquire);
-        return buffers[readIndex].clone(); // Return a copy
-    }
-};
+#include <type_traits>
 
 class DoubleBufferVec {
   private:
@@ -101,37 +36,101 @@ class DoubleBufferVec {
     }
 };
 
+// Latest value from one writer thread to one reader thread, wait-free on both sides.
+// The writer fills its own slot and swaps it with the middle one, the reader swaps
+// its slot with the middle one only if that holds something newer. Nobody ever
+// writes a slot another thread is reading, so the reader can borrow its slot
+// without copying. Slots are assigned to, vectors keep their capacity.
 template <typename T>
-class DoubleBuffer {
+class TripleBuffer {
   private:
-    std::array<T, 2> buffers;
-    std::atomic<int> activeBuffer{0}; // read buffer
+    static constexpr int INDEX = 0x3;
+    static constexpr int DIRTY = 0x4; // middle slot holds a value the reader has not seen
+
+    std::array<T, 3> m_buffers;
+    std::atomic<int> m_middle{2};
+    int m_write{0};  // writer only
+    int m_latest{2}; // writer only, slot of the last update, nobody writes it until the next one
+    int m_read{1};   // reader only
 
   public:
-    DoubleBuffer() = default;
+    TripleBuffer() = default;
 
-    explicit DoubleBuffer(const T& initialData)
+    explicit TripleBuffer(const T& initialData)
     {
-        buffers[0] = cloneData(initialData);
-        buffers[1] = cloneData(initialData);
+        m_buffers.fill(initialData);
     }
 
+    // writer thread
     void update(const T& data)
     {
-        int writeIndex = 1 - activeBuffer.load(std::memory_order_acquire);
-        buffers[writeIndex] = cloneData(data);
-        activeBuffer.store(writeIndex, std::memory_order_release);
+        m_buffers[m_write] = data;
+        m_latest = m_write;
+        m_write = m_middle.exchange(m_write | DIRTY, std::memory_order_acq_rel) & INDEX;
     }
 
-    T get() const
+    // writer thread, what it last published
+    const T& latest() const
     {
-        int readIndex = activeBuffer.load(std::memory_order_acquire);
-        return cloneData(buffers[readIndex]);
+        return m_buffers[m_latest];
     }
 
+    // reader thread, the reference stays valid until its next get()
+    const T& get()
+    {
+        if (m_middle.load(std::memory_order_relaxed) & DIRTY) {
+            m_read = m_middle.exchange(m_read, std::memory_order_acq_rel) & INDEX;
+        }
+        return m_buffers[m_read];
+    }
+};
+
+// Small trivially copyable values (points, rects) for any number of readers.
+// Readers copy the value out and retry if the writer was in the middle of an
+// update. The value is stored as atomic words so a torn read is detected
+// instead of being a data race.
+template <typename T>
+class SeqLock {
   private:
-    T cloneData(const T& data) const
+    static_assert(std::is_trivially_copyable_v<T>, "SeqLock copies the value bytewise");
+    static constexpr size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint32_t> m_sequence{0}; // odd while an update is in progress
+    std::array<std::atomic<uint64_t>, WORDS> m_words{};
+
+  public:
+    SeqLock() { update(T()); }
+    explicit SeqLock(const T& initialData) { update(initialData); }
+
+    // one writer at a time
+    void update(const T& data)
+    {
+        uint64_t words[WORDS] = {};
+        std::memcpy(words, &data, sizeof(T));
+
+        uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+        m_sequence.store(sequence + 1, std::memory_order_relaxed);
+        for (size_t i = 0; i < WORDS; i++) {
+            m_words[i].store(words[i], std::memory_order_release); // not visible before the odd sequence
+        }
+        m_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    T get() const
     {
-        return T(data);
+        uint64_t words[WORDS];
+        uint32_t before;
+        uint32_t after;
+        do {
+            before = m_sequence.load(std::memory_order_acquire);
+            for (size_t i = 0; i < WORDS; i++) {
+                words[i] = m_words[i].load(std::memory_order_acquire); // keeps the second sequence load after it
+            }
+            after = m_sequence.load(std::memory_order_relaxed);
+        } while (before != after || (before & 1));
+
+        T data;
+        std::memcpy(&data, words, sizeof(T));
+        return data;
     }
 };
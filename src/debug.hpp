@@ -2,6 +2,7 @@
 
 #include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -25,6 +26,14 @@
 #define D_CPU(x)
 #endif
 
+#ifdef DEBUG_ALLOC
+#define D_ALLOC(x) x
+uint64_t alloc_count();            // heap allocations made by the calling thread so far (alloc_count.cpp)
+void install_mat_alloc_counter(); // cv::Mat buffers count towards alloc_count() as well
+#else
+#define D_ALLOC(x)
+#endif
+
 class CpuUsageMonitor {
   public:
     CpuUsageMonitor()
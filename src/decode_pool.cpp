@@ -0,0 +1,137 @@
+#include "decode_pool.hpp"
+#include "debug.hpp"
+#include "globals.hpp"
+#include <algorithm>
+#include <iostream>
+
+DecodePool& DecodePool::get()
+{
+    static DecodePool pool;
+    return pool;
+}
+
+DecodePool::~DecodePool()
+{
+    stop();
+}
+
+void DecodePool::start(int workers)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_running) { return; }
+
+    if (workers <= 0) { workers = std::max(1u, std::thread::hardware_concurrency()); }
+    m_running = true;
+    m_stopped = false;
+    for (int i = 0; i < workers; i++) {
+        m_threads.emplace_back([this] { run(); });
+    }
+    D(std::cout << "decode pool: " << workers << " workers" << std::endl);
+}
+
+void DecodePool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if (!m_running) { return; }
+        m_running = false;
+        m_stopped = true;
+    }
+    m_cv.notify_all();
+
+    for (auto& thread : m_threads) {
+        if (thread.joinable()) { thread.join(); }
+    }
+    m_threads.clear();
+}
+
+void DecodePool::submit(std::function<void()> task)
+{
+    if (!m_running && !m_stopped) { start(0); } // readers started before the pool was configured
+    {
+        std::unique_lock<std::mutex> lock(m_mtx);
+        if (m_stopped) {
+            // no worker will take it, and a reader waits for its decode task to finish
+            lock.unlock();
+            task();
+            return;
+        }
+        m_tasks.push_back(std::move(task));
+    }
+    m_cv.notify_one();
+}
+
+int DecodePool::workers()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return static_cast<int>(m_threads.size());
+}
+
+void DecodePool::run()
+{
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mtx);
+            m_cv.wait(lock, [&] { return !m_tasks.empty() || !m_running; });
+            if (m_tasks.empty()) { return; } // stopped, what was queued has run
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void DecodePool::set_thread_budget(int threads)
+{
+    std::lock_guard<std::mutex> lock(m_sessions_mtx);
+    m_thread_budget = threads;
+}
+
+int DecodePool::add_session()
+{
+    std::lock_guard<std::mutex> lock(m_sessions_mtx);
+    m_sessions.emplace_back();
+    return static_cast<int>(m_sessions.size()) - 1;
+}
+
+void DecodePool::set_active(int session, bool active)
+{
+    std::lock_guard<std::mutex> lock(m_sessions_mtx);
+    m_sessions[session].active = active;
+}
+
+void DecodePool::set_priority(int session, DECODE_PRIORITY priority)
+{
+    std::lock_guard<std::mutex> lock(m_sessions_mtx);
+    m_sessions[session].priority = priority;
+}
+
+static int priority_weight(DECODE_PRIORITY priority)
+{
+    switch (priority) {
+        case DECODE_PRIORITY_HIGH:   return 4;
+        case DECODE_PRIORITY_NORMAL: return 1;
+        default:                     return 0;
+    }
+}
+
+int DecodePool::threads(int session)
+{
+    std::lock_guard<std::mutex> lock(m_sessions_mtx);
+
+    int budget = m_thread_budget > 0 ? m_thread_budget : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    int active = 0;
+    int weights = 0;
+    for (const Session& s : m_sessions) {
+        if (!s.active) { continue; }
+        active++;
+        weights += priority_weight(s.priority);
+    }
+
+    // one thread each, what is left over goes by weight
+    int spare = budget - active;
+    int weight = priority_weight(m_sessions[session].priority);
+    if (spare <= 0 || weights == 0 || weight == 0) { return 1; }
+    return std::min(1 + spare * weight / weights, DECODE_THREADS_MAX);
+}
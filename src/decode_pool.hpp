@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Share of the decoder thread budget a reader gets
+enum DECODE_PRIORITY {
+    DECODE_PRIORITY_LOW,    // not on screen, one thread
+    DECODE_PRIORITY_NORMAL, // on screen in a grid
+    DECODE_PRIORITY_HIGH,   // displayed large or detected on
+};
+
+// Process wide pool of decode workers shared by all FrameReaders.
+// Reader threads only demux (they sleep in the kernel waiting for packets),
+// the CPU heavy decoding is bounded by the number of workers here instead of
+// by the number of channels. A reader submits itself when it has packets
+// queued and is never decoded by two workers at the same time.
+//
+// The pool also owns the decoder thread budget: every connected reader
+// (session) gets one codec thread, the rest of the budget is split by priority.
+class DecodePool {
+  public:
+    static DecodePool& get();
+
+    void start(int workers); // 0 = one per hardware thread, does nothing if already started
+    void stop(); // queued tasks still run, later ones run on the caller
+    void submit(std::function<void()> task);
+    int workers();
+
+    void set_thread_budget(int threads); // codec threads across all readers, 0 = one per cpu thread
+    int add_session();                   // one per reader, for its lifetime
+    void set_active(int session, bool active);
+    void set_priority(int session, DECODE_PRIORITY priority);
+    int threads(int session); // codec threads the session should currently decode with
+
+  private:
+    struct Session {
+        bool active{false};
+        DECODE_PRIORITY priority{DECODE_PRIORITY_NORMAL};
+    };
+
+    DecodePool() = default;
+    ~DecodePool();
+    void run();
+
+  private:
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mtx;
+    std::condition_variable m_cv;
+    std::atomic<bool> m_running{false};
+    std::atomic<bool> m_stopped{false}; // stop() was called, no automatic restart
+
+    std::mutex m_sessions_mtx;
+    std::vector<Session> m_sessions;
+    int m_thread_budget{0};
+};
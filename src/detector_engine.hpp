@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <string>
+
+enum DETECT_ENGINE {
+    DETECT_ENGINE_KNN,  // cv::BackgroundSubtractorKNN
+    DETECT_ENGINE_MOG2, // cv::BackgroundSubtractorMOG2
+    DETECT_ENGINE_CNT,  // cv::bgsegm::BackgroundSubtractorCNT
+    DETECT_ENGINE_DIFF, // running average background, absolute difference
+    DETECT_ENGINE_EWMA, // same in fixed point, one SIMD pass over the luma
+    DETECT_ENGINE_MV,   // the encoder's motion vectors (Frame::motion), no pixels at all
+    DETECT_ENGINE_COUNT,
+};
+
+struct DetectEngineParams {
+    int engine{DETECT_ENGINE_KNN};
+    int history{0};        // frames the background adapts over, 0 = engine default
+    double threshold{0.0}; // foreground threshold in the engine's own unit, 0 = engine default
+};
+
+// Turns detection frames (luma or BGR, motion vector lengths for mv) into a binary foreground mask (255 = motion).
+// One instance per detection tile, it owns that tile's background model.
+class DetectorEngine {
+  public:
+    virtual ~DetectorEngine() = default;
+    virtual int apply(const cv::Mat& frame, cv::Mat& mask) = 0; // returns the number of foreground pixels
+
+    static std::unique_ptr<DetectorEngine> create(const DetectEngineParams& params);
+    static int parse(const std::string& name); // DETECT_ENGINE, -1 if unknown
+    static const char* name(int engine);
+};
+
+double thread_cpu_ms(); // CPU time of the calling thread
+
+// bench_cpu: every engine runs on the same detection frames, CPU time per frame is printed
+class DetectEngineBench {
+  public:
+    explicit DetectEngineBench(const DetectEngineParams& params);
+    void run(const cv::Mat& frame);
+
+  private:
+    std::array<std::unique_ptr<DetectorEngine>, DETECT_ENGINE_COUNT> m_engines;
+    std::array<cv::Mat, DETECT_ENGINE_COUNT> m_masks;
+    std::array<double, DETECT_ENGINE_COUNT> m_cpu_ms{};
+    int m_frames{0};
+};
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include "globals.hpp"
+
+// Decoded frame shared between a FrameReader and its consumers.
+// Consumers only ever see it as const, the pixels belong to the reader's FramePool.
+struct Frame {
+    cv::Mat mat;  // BGR, empty if the reader skips the colour conversion
+    cv::Mat luma; // Y plane of the decoded frame, only filled if the reader was asked for it
+    // encoder motion vectors, longest length per MOTION_VECTOR_BLOCK cell in MOTION_VECTOR_UNIT (CV_8UC1),
+    // only filled if the reader was asked for it and the frame has any (keyframes do not)
+    cv::Mat motion;
+    int channel{0};
+    uint64_t generation{0}; // set by the publisher, increases with every published frame
+
+    // latency tracing, stamped along the pipeline
+    int64_t pts{0};
+    std::chrono::steady_clock::time_point received;  // packet arrived (demux)
+    std::chrono::steady_clock::time_point decoded;   // left the decoder
+    std::chrono::steady_clock::time_point published; // visible to consumers
+
+    // focus detection frames: motion rectangles in mat coordinates, drawn once scaled to the window
+    std::vector<cv::Rect> rects;
+    cv::Rect region; // largest, empty if none
+
+    // channel and stamps of the frame this one was made from (not the generation)
+    void copy_meta(const Frame& src)
+    {
+        channel = src.channel;
+        pts = src.pts;
+        received = src.received;
+        decoded = src.decoded;
+        published = src.published;
+    }
+};
+
+using FramePtr = std::shared_ptr<const Frame>;
+
+// Per-reader pool of recycled frame buffers.
+// A frame is free again once the pool holds the only reference to it,
+// so in steady state sws_scale writes into memory that is already allocated.
+// Only one thread at a time calls acquire() (the reader or the decode worker running it).
+class FramePool {
+  public:
+    FramePool() { m_frames.reserve(FRAME_POOL_SIZE); }
+
+    std::shared_ptr<Frame> acquire()
+    {
+        m_acquires.fetch_add(1, std::memory_order_relaxed);
+
+        for (auto& f : m_frames) {
+            if (f.use_count() == 1) {
+                std::atomic_thread_fence(std::memory_order_acquire); // last reader is done with the pixels
+                return f;
+            }
+        }
+
+        auto frame = std::make_shared<Frame>();
+        m_frames.push_back(frame);
+        m_allocations.fetch_add(1, std::memory_order_relaxed);
+        return frame;
+    }
+
+    std::shared_ptr<Frame> acquire(int width, int height, int type)
+    {
+        std::shared_ptr<Frame> frame = acquire();
+        create(frame->mat, width, height, type);
+        return frame;
+    }
+
+    // (re)allocates a pooled mat only if its geometry changed
+    void create(cv::Mat& mat, int width, int height, int type)
+    {
+        if (mat.rows != height || mat.cols != width || mat.type() != type) {
+            mat.create(height, width, type);
+            m_allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    size_t size() const { return m_frames.size(); }
+    uint64_t allocations() const { return m_allocations.load(std::memory_order_relaxed); }
+    uint64_t acquires() const { return m_acquires.load(std::memory_order_relaxed); }
+
+  private:
+    std::vector<std::shared_ptr<Frame>> m_frames;
+    std::atomic<uint64_t> m_allocations{0};
+    std::atomic<uint64_t> m_acquires{0};
+};
+
+// libstdc++'s std::atomic<shared_ptr> locks with a pointer bit ThreadSanitizer does not see,
+// `make tsan` takes the mutex based free functions instead
+#if defined(__cpp_lib_atomic_shared_ptr) && !defined(DEBUG_TSAN)
+#define FRAME_MAILBOX_ATOMIC_SHARED_PTR
+#endif
+
+// Single producer, latest-wins frame mailbox.
+// publish() overwrites whatever was not taken yet instead of dropping the new frame,
+// so a slow consumer skips frames but never falls behind. peek() is an O(1) zero-copy
+// snapshot (RCU style) that stays valid for as long as the caller holds it, take()
+// hands out each frame at most once. Producer and consumer state sit on separate
+// cache lines, the counters tell how many frames a consumer never saw.
+class FrameMailbox {
+  public:
+    void publish(FramePtr frame)
+    {
+        uint64_t generation = frame ? frame->generation : 0;
+#ifdef FRAME_MAILBOX_ATOMIC_SHARED_PTR
+        m_frame.store(std::move(frame), std::memory_order_release);
+#else
+        std::atomic_store_explicit(&m_frame, std::move(frame), std::memory_order_release);
+#endif
+        m_generation.store(generation, std::memory_order_release);
+    }
+
+    FramePtr peek() const
+    {
+#ifdef FRAME_MAILBOX_ATOMIC_SHARED_PTR
+        return m_frame.load(std::memory_order_acquire);
+#else
+        return std::atomic_load_explicit(&m_frame, std::memory_order_acquire);
+#endif
+    }
+
+    // newest frame not taken before, nullptr if there is none
+    FramePtr take()
+    {
+        uint64_t taken = m_taken.load(std::memory_order_acquire);
+        if (generation() == taken) { return nullptr; }
+
+        FramePtr frame = peek();
+        if (!frame) { return nullptr; }
+        do {
+            if (taken >= frame->generation) { return nullptr; }
+        } while (!m_taken.compare_exchange_weak(taken, frame->generation, std::memory_order_acq_rel));
+
+        m_consumed.fetch_add(1, std::memory_order_relaxed);
+        m_overwritten.fetch_add(frame->generation - taken - 1, std::memory_order_relaxed);
+        return frame;
+    }
+
+    // generation of the last published frame, cheap check before taking a snapshot
+    uint64_t generation() const { return m_generation.load(std::memory_order_acquire); }
+
+    uint64_t produced() const { return generation(); }
+    uint64_t consumed() const { return m_consumed.load(std::memory_order_relaxed); }
+    uint64_t overwritten() const { return m_overwritten.load(std::memory_order_relaxed); } // replaced before anyone took them
+
+  private:
+    // producer
+#ifdef FRAME_MAILBOX_ATOMIC_SHARED_PTR
+    alignas(CACHE_LINE_SIZE) std::atomic<FramePtr> m_frame;
+#else
+    alignas(CACHE_LINE_SIZE) FramePtr m_frame;
+#endif
+    std::atomic<uint64_t> m_generation{0};
+
+    // consumer
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_taken{0};
+    std::atomic<uint64_t> m_consumed{0};
+    std::atomic<uint64_t> m_overwritten{0};
+};
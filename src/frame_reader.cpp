@@ -1,8 +1,15 @@
 #include "debug.hpp"
+#include "decode_pool.hpp"
 #include "globals.hpp"
+#include "latency.hpp"
+#include "stream_cache.hpp"
 #include "utils.hpp"
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstring>
+#include <mutex>
 #include <opencv2/opencv.hpp>
 #include <string>
 #include <sys/types.h>
@@ -11,6 +18,8 @@
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
+#include <libavutil/motion_vector.h>
+#include <libavutil/pixdesc.h>
 #include <libswscale/swscale.h>
 }
 
@@ -21,6 +30,7 @@ FrameReader::FrameReader(int channel,
                          const std::string& username,
                          const std::string& password,
                          int subtype,
+                         const InputSource& input,
                          bool autostart,
                          bool has_placeholder)
     :
@@ -29,8 +39,10 @@ FrameReader::FrameReader(int channel,
       m_username(username),
       m_password(password),
       m_channel(channel),
-      m_subtype(subtype)
+      m_subtype(subtype),
+      m_input(input)
 {
+    m_session = DecodePool::get().add_session();
 
     if (has_placeholder) {
         put_placeholder();
@@ -43,8 +55,11 @@ FrameReader::FrameReader(int channel,
 
 void FrameReader::put_placeholder()
 {
-    // Create a black placeholder image
-    cv::Mat placeholder_cpu(cv::Size(1000, 1000), CV_8UC3, cv::Scalar(0, 0, 0));
+    // Create a black placeholder image (drawn straight into a pooled frame)
+    std::shared_ptr<Frame> placeholder = m_pool.acquire(1000, 1000, CV_8UC3);
+    placeholder->channel = m_channel;
+    cv::Mat& placeholder_cpu = placeholder->mat;
+    placeholder_cpu.setTo(cv::Scalar(0, 0, 0));
 
     const cv::Scalar text_color(255, 255, 255);
     const double font_scale = 10;
@@ -61,17 +76,84 @@ void FrameReader::put_placeholder()
     // Draw white border
     cv::rectangle(placeholder_cpu, cv::Rect(0, 0, placeholder_cpu.cols, placeholder_cpu.rows), cv::Scalar(255, 255, 255), 3);
 
-    cv::UMat placeholder;
-    placeholder_cpu.copyTo(placeholder);
-    m_frame_buffer.push(placeholder);
-    m_frame_dbuffer.update(placeholder);
+    publish(placeholder);
 }
 
-cv::UMat FrameReader::get_latest_frame(bool no_empty_frame)
+// Every consumer gets the same frame, only the reference count changes
+void FrameReader::publish(std::shared_ptr<Frame> frame)
 {
-    if (no_empty_frame) { return m_frame_dbuffer.get(); }
-    auto frame = m_frame_buffer.pop();
-    return frame ? *frame : cv::UMat();
+    frame->generation = ++m_generation;
+    frame->published = std::chrono::steady_clock::now();
+    LatencyTracker::get().record(m_channel, LATENCY_STAGE_DECODE, frame->received, frame->decoded);
+    LatencyTracker::get().record(m_channel, LATENCY_STAGE_CONVERT, frame->decoded, frame->published);
+    m_frame_mailbox.publish(std::move(frame));
+    if (m_on_frame) { m_on_frame(); }
+
+    if (m_first_frame_pending.exchange(false)) {
+        auto ttff = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_start_time).count();
+        std::cout << "first frame: " << m_channel << " -- " << ttff << " ms" << std::endl;
+    }
+}
+
+// no_empty_frame == false: the newest frame not returned before (nullptr if nothing new)
+FramePtr FrameReader::get_latest_frame(bool no_empty_frame)
+{
+    return no_empty_frame ? m_frame_mailbox.peek() : m_frame_mailbox.take();
+}
+
+uint64_t FrameReader::get_generation()
+{
+    return m_frame_mailbox.generation();
+}
+
+void FrameReader::set_luma(bool luma)
+{
+    m_luma = luma;
+}
+
+void FrameReader::set_bgr(bool bgr)
+{
+    m_bgr = bgr;
+}
+
+void FrameReader::set_motion_vectors(bool vectors)
+{
+    m_vectors = vectors;
+}
+
+void FrameReader::set_decode_level(DECODE_LEVEL level)
+{
+    m_decode_level = level;
+}
+
+DECODE_LEVEL FrameReader::get_decode_level()
+{
+    return m_decode_level.load();
+}
+
+void FrameReader::set_decode_priority(DECODE_PRIORITY priority)
+{
+    if (m_decode_priority.exchange(priority) != priority) {
+        DecodePool::get().set_priority(m_session, priority);
+    }
+}
+
+DecodeStats FrameReader::get_decode_stats()
+{
+    DecodeStats stats;
+    stats.decode_ms = m_decode_ms.load();
+    stats.queue_depth = m_queue_depth.load();
+    stats.threads = m_codec_threads.load();
+    stats.dropped = m_packets_dropped.load();
+    stats.produced = m_frame_mailbox.produced();
+    stats.consumed = m_frame_mailbox.consumed();
+    stats.overwritten = m_frame_mailbox.overwritten();
+    return stats;
+}
+
+void FrameReader::set_on_frame(std::function<void()> on_frame)
+{
+    m_on_frame = std::move(on_frame);
 }
 
 double FrameReader::get_fps()
@@ -85,6 +167,10 @@ void FrameReader::stop()
     D(std::cout << "[" << m_channel << "] reader stop" << std::endl);
     m_running = false;
     m_cv.notify_one();
+    {
+        std::lock_guard<std::mutex> lock(m_packets_mtx);
+        m_packets_cv.notify_all(); // demux thread waiting for room in the queue
+    }
 
     if (m_thread.joinable()) {
         D(std::cout << "[" << m_channel << "] reader join" << std::endl);
@@ -104,6 +190,24 @@ std::string FrameReader::construct_rtsp_url(const std::string& ip, const std::st
            "&subtype=" + std::to_string(st);
 }
 
+// 8 bit YUV formats (planar or semi-planar) keep the luma in data[0]
+static bool has_luma_plane(AVPixelFormat format)
+{
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_HWACCEL))) { return false; }
+    return (desc->flags & AV_PIX_FMT_FLAG_PLANAR) && desc->nb_components >= 3 && desc->comp[0].plane == 0 && desc->comp[0].depth == 8 && desc->comp[0].step == 1;
+}
+
+static AVDiscard decode_level_discard(DECODE_LEVEL level)
+{
+    switch (level) {
+        case DECODE_LEVEL_NONREF: return AVDISCARD_NONREF;
+        case DECODE_LEVEL_NONKEY: return AVDISCARD_NONKEY;
+        case DECODE_LEVEL_PAUSED: return AVDISCARD_ALL;
+        default:                  return AVDISCARD_DEFAULT;
+    }
+}
+
 // Place this helper somewhere in the file scope (above the method)
 static enum AVPixelFormat get_vaapi_format(AVCodecContext* ctx, const enum AVPixelFormat* pix_fmts)
 {
@@ -119,105 +223,237 @@ static enum AVPixelFormat get_vaapi_format(AVCodecContext* ctx, const enum AVPix
     return pix_fmts[0];
 }
 
+// frames per second over the last 30 published frames
+void FrameReader::update_fps()
+{
+    m_fps_frames++;
+    if (m_fps_frames % 30 == 0) {
+        auto end_time = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsed = end_time - m_fps_start;
+        double fps = 30.0 / elapsed.count();
+        captured_fps = fps;
+        if (m_decode_packets) {
+            m_decode_ms = m_decode_ns / 1e6 / m_decode_packets;
+            m_decode_ns = 0;
+            m_decode_packets = 0;
+        }
+#ifdef DEBUG_FPS
+        if (m_fps_frames % 100 == 0) {
+            std::cout << "Channel " << m_channel << " Frame Rate: " << fps << " FPS" << std::endl;
+            std::cout << "Channel " << m_channel << " Frame Pool: " << m_pool.size() << " frames, "
+                      << m_pool.allocations() << " allocations / " << m_pool.acquires() << " frames, "
+                      << m_hw_copies << " hw copies, " << m_packets_dropped << " dropped packets" << std::endl;
+            std::cout << "Channel " << m_channel << " Decode: " << m_decode_ms << " ms/packet, queue "
+                      << m_queue_depth << ", " << m_codec_threads << " threads" << std::endl;
+            std::cout << "Channel " << m_channel << " Frames: " << m_frame_mailbox.produced() << " produced, "
+                      << m_frame_mailbox.consumed() << " consumed, " << m_frame_mailbox.overwritten() << " overwritten" << std::endl;
+        }
+#endif
+        m_fps_start = std::chrono::high_resolution_clock::now();
+    }
+}
+
+bool FrameReader::wait_until(std::chrono::steady_clock::time_point deadline)
+{
+    std::unique_lock<std::mutex> lock(m_mtx);
+    return !m_cv.wait_until(lock, deadline, [&] { return !m_running; });
+}
+
+void FrameReader::read_synthetic()
+{
+    int w = (m_channel == 0 || m_subtype) ? W_0 : W_HD;
+    int h = (m_channel == 0 || m_subtype) ? H_0 : H_HD;
+    std::cout << "connected: " << m_channel << " -- synthetic " << w << "x" << h << std::endl;
+
+    const auto frame_time = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / SYNTHETIC_FPS));
+    auto next = std::chrono::steady_clock::now();
+    m_fps_start = std::chrono::high_resolution_clock::now();
+
+    for (uint64_t index = 0; m_running; index++) {
+        // emulate what the decoder would skip at the current decode level
+        DECODE_LEVEL level = m_decode_level;
+        bool skip = (level == DECODE_LEVEL_PAUSED) ||
+                    (level == DECODE_LEVEL_NONKEY && index % SYNTHETIC_GOP != 0) ||
+                    (level == DECODE_LEVEL_NONREF && index % 2 != 0);
+
+        if (!skip) {
+            std::shared_ptr<Frame> image = m_pool.acquire(w, h, CV_8UC3);
+            image->channel = m_channel;
+            image->pts = static_cast<int64_t>(index);
+            image->received = std::chrono::steady_clock::now();
+            if (m_channel == 0) { render_synthetic_mosaic(image->mat, index); }
+            else { render_synthetic(image->mat, m_channel, index); }
+
+            if (m_luma) {
+                m_pool.create(image->luma, w, h, CV_8UC1);
+                cv::cvtColor(image->mat, image->luma, cv::COLOR_BGR2GRAY);
+            }
+            else {
+                image->luma.release();
+            }
+
+            image->decoded = image->received; // rendering is the "decode"
+            publish(std::move(image));
+            m_active = true;
+            update_fps();
+        }
+
+        if (m_input.realtime) {
+            next += frame_time;
+            if (!wait_until(next)) { break; }
+        }
+    }
+
+    m_active = false;
+    D(std::cout << "Exiting readFrames() thread for channel " << m_channel << std::endl);
+}
+
+static int find_video_stream(AVFormatContext* formatCtx)
+{
+    for (unsigned int i = 0; i < formatCtx->nb_streams; i++) {
+        if (formatCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// lets stop() interrupt a blocking open/read instead of waiting for the network timeout
+static int interrupt_callback(void* opaque)
+{
+    return !static_cast<FrameReader*>(opaque)->is_running();
+}
+
 void FrameReader::connect_and_read()
 {
-    bool connected = false;
+    if (m_input.type == INPUT_TYPE_SYNTHETIC) {
+        read_synthetic();
+        return;
+    }
 
     std::cout << "start capture: " << m_channel << std::endl;
-    std::string rtsp_url = construct_rtsp_url(m_ip, m_username, m_password, m_subtype);
+    std::string url = (m_input.type == INPUT_TYPE_DAHUA) ? construct_rtsp_url(m_ip, m_username, m_password, m_subtype) : m_input.resolve(m_channel);
+
+    static std::once_flag network_init;
+    std::call_once(network_init, [] { avformat_network_init(); });
+
+    // Retry loop for connection, also reconnects when the stream fails.
+    // A lost stream is reopened after a delay that doubles while sessions fail without a frame.
+    int lost_retry_ms = CONN_LOST_RETRY_MS;
+    while (m_running) {
+        if (!open_input(url)) {
+            std::cerr << "Failed to connect or find video stream for channel " << m_channel << std::endl;
+            if (!wait_until(std::chrono::steady_clock::now() + std::chrono::milliseconds(CONN_RETRY_MS))) { break; }
+            continue;
+        }
 
-    avformat_network_init();
-    AVFormatContext* formatCtx = avformat_alloc_context();
+        uint64_t generation = get_generation();
+        read_packets();
+        close_input();
+        if (!m_running) { break; }
 
-    set_thread_affinity(m_channel % std::thread::hardware_concurrency());
+        lost_retry_ms = (get_generation() != generation) ? CONN_LOST_RETRY_MS : std::min(lost_retry_ms * 2, CONN_RETRY_MS);
+        std::cerr << "Lost stream for channel " << m_channel << ", reconnecting in " << lost_retry_ms << " ms" << std::endl;
+        if (!wait_until(std::chrono::steady_clock::now() + std::chrono::milliseconds(lost_retry_ms))) { break; }
+    }
+
+    D(std::cout << "Exiting readFrames() thread for channel " << m_channel << std::endl);
+}
 
-    // Retry loop for connection
-    while (!connected) {
-        AVDictionary* options = nullptr;
+bool FrameReader::open_input(const std::string& url)
+{
+    bool is_rtsp = url.rfind("rtsp://", 0) == 0;
+
+    AVDictionary* options = nullptr;
+    if (is_rtsp) {
         av_dict_set(&options, "rtsp_transport", "tcp", 0);
         av_dict_set(&options, "stimeout", "3000000", 0); // 3s timeout (microseconds)
-        av_dict_set(&options, "fflags", "discardcorrupt", 0);
         av_dict_set(&options, "packet_buffer_size", "2048000", 0);
+    }
+    av_dict_set(&options, "fflags", "discardcorrupt", 0);
+
+    // stream seen before: skip probing, the cached parameters fill in what the header leaves out
+    auto open_start = std::chrono::steady_clock::now();
+    StreamParams cached;
+    bool use_cache = StreamCache::get().lookup(url, cached);
+    if (use_cache) {
+        av_dict_set(&options, "probesize", "32", 0);
+        av_dict_set(&options, "analyzeduration", "0", 0);
+    }
 
-        if (avformat_open_input(&formatCtx, rtsp_url.c_str(), NULL, &options) == 0) {
-            if (avformat_find_stream_info(formatCtx, NULL) >= 0) {
-                for (unsigned int i = 0; i < formatCtx->nb_streams; i++) {
-                    if (formatCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-                        connected = true;
-                        break;
-                    }
-                }
-            }
-        }
+    m_format_ctx = avformat_alloc_context();
+    m_format_ctx->interrupt_callback.callback = interrupt_callback;
+    m_format_ctx->interrupt_callback.opaque = this;
 
-        if (!connected) {
-            if (formatCtx) avformat_close_input(&formatCtx);
-            std::cerr << "Failed to connect or find video stream for channel " << m_channel << std::endl;
+    // frees the context on failure
+    int open_err = avformat_open_input(&m_format_ctx, url.c_str(), NULL, &options);
+    av_dict_free(&options);
+    if (open_err != 0) { return false; }
 
-            {
-                std::unique_lock<std::mutex> lock(m_mtx);
-                m_cv.wait_for(lock, std::chrono::milliseconds(CONN_RETRY_MS), [&] { return !m_running; });
-            }
-        }
+    // recorded media (files, seekable urls) waits for the decoder, only live sessions drop to a keyframe
+    bool seekable = m_format_ctx->pb && (m_format_ctx->pb->seekable & AVIO_SEEKABLE_NORMAL);
+    m_backpressure = m_input.type == INPUT_TYPE_FILE || (!is_rtsp && seekable);
 
-        if (!m_running) {
-            D(std::cout << "Exiting readFrames() thread for channel " << m_channel << std::endl);
-            avformat_close_input(&formatCtx);
-            return;
-        }
+    m_video_stream = find_video_stream(m_format_ctx);
+    if (use_cache && (m_video_stream == -1 || m_format_ctx->streams[m_video_stream]->codecpar->codec_id != cached.codec_id)) {
+        use_cache = false; // stream changed since it was cached
+    }
+    if (!use_cache) {
+        m_video_stream = (avformat_find_stream_info(m_format_ctx, NULL) >= 0) ? find_video_stream(m_format_ctx) : -1;
+    }
+    if (m_video_stream == -1) {
+        avformat_close_input(&m_format_ctx);
+        return false;
     }
 
-    // find video stream index
-    int videoStreamIndex = -1;
-    for (unsigned int i = 0; i < formatCtx->nb_streams; i++) {
-        if (formatCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-            videoStreamIndex = i;
-            break;
+    AVCodecParameters* codecParams = m_format_ctx->streams[m_video_stream]->codecpar;
+    if (use_cache) {
+        if (codecParams->extradata_size == 0 && !cached.extradata.empty()) {
+            codecParams->extradata = static_cast<uint8_t*>(av_mallocz(cached.extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE));
+            if (codecParams->extradata) {
+                std::memcpy(codecParams->extradata, cached.extradata.data(), cached.extradata.size());
+                codecParams->extradata_size = static_cast<int>(cached.extradata.size());
+            }
         }
+        if (codecParams->width == 0 || codecParams->height == 0) {
+            codecParams->width = cached.width;
+            codecParams->height = cached.height;
+        }
+        if (codecParams->format < 0) { codecParams->format = cached.format; }
     }
-    if (videoStreamIndex == -1) {
-        avformat_close_input(&formatCtx);
-        throw std::runtime_error("No video stream found for channel " + std::to_string(m_channel));
+    else if (codecParams->width > 0 && codecParams->height > 0) {
+        StreamParams params;
+        params.codec_id = codecParams->codec_id;
+        params.width = codecParams->width;
+        params.height = codecParams->height;
+        params.format = codecParams->format;
+        params.extradata.assign(codecParams->extradata, codecParams->extradata + codecParams->extradata_size);
+        StreamCache::get().store(url, params);
     }
 
-    AVCodecParameters* codecParams = formatCtx->streams[videoStreamIndex]->codecpar;
-
     // Use the standard decoder (not vaapi-specific decoder names)
-    const AVCodec* decoder = avcodec_find_decoder(codecParams->codec_id);
-    if (!decoder) {
-        avformat_close_input(&formatCtx);
+    if (!avcodec_find_decoder(codecParams->codec_id)) {
+        avformat_close_input(&m_format_ctx);
         throw std::runtime_error("No suitable decoder found for channel " + std::to_string(m_channel));
     }
+    m_codec_par = avcodec_parameters_alloc();
+    avcodec_parameters_copy(m_codec_par, codecParams);
 
-    AVCodecContext* codecCtx = avcodec_alloc_context3(decoder);
-    if (!codecCtx) {
-        avformat_close_input(&formatCtx);
-        throw std::runtime_error("Failed to alloc codec context for channel " + std::to_string(m_channel));
+    // Attempt to create a VAAPI device for HW acceleration (motion vectors only come from the software decoders)
+    if (m_vectors) {
+        std::cout << "motion vectors exported for channel " << m_channel << " -- using software decode." << std::endl;
     }
-    avcodec_parameters_to_context(codecCtx, codecParams);
-
-    // low-latency / threading hints
-    codecCtx->flags |= AV_CODEC_FLAG_LOW_DELAY;
-    // Use more threads for software decoding
-    codecCtx->thread_count = 0; // 0 = auto-detect optimal thread count
-    codecCtx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
-    codecCtx->skip_frame = AVDISCARD_DEFAULT;
-
-    // Attempt to create a VAAPI device for HW acceleration
-    AVBufferRef* hw_device_ctx = nullptr;
-    if (codecParams->codec_id == AV_CODEC_ID_H264 || codecParams->codec_id == AV_CODEC_ID_HEVC) {
+    else if (codecParams->codec_id == AV_CODEC_ID_H264 || codecParams->codec_id == AV_CODEC_ID_HEVC) {
         // Try default first (NULL), then fall back to common paths
-        int err = av_hwdevice_ctx_create(&hw_device_ctx, AV_HWDEVICE_TYPE_VAAPI,
+        int err = av_hwdevice_ctx_create(&m_hw_device_ctx, AV_HWDEVICE_TYPE_VAAPI,
                                          NULL, NULL, 0); // NULL = auto-detect
         if (err < 0) {
             // Try explicit paths if auto-detect fails
-            err = av_hwdevice_ctx_create(&hw_device_ctx, AV_HWDEVICE_TYPE_VAAPI,
+            err = av_hwdevice_ctx_create(&m_hw_device_ctx, AV_HWDEVICE_TYPE_VAAPI,
                                          "/dev/dri/renderD128", NULL, 0);
         }
 
         if (err == 0) {
-            codecCtx->hw_device_ctx = av_buffer_ref(hw_device_ctx);
-            codecCtx->get_format = get_vaapi_format;
             std::cout << "VAAPI hardware acceleration enabled for channel " << m_channel << std::endl;
         }
         else {
@@ -228,163 +464,455 @@ void FrameReader::connect_and_read()
         }
     }
 
-    // codec options (don't set encoder-only options)
-    AVDictionary* codecOptions = nullptr;
-
-    // open codec
-    if (avcodec_open2(codecCtx, decoder, &codecOptions) < 0) {
-        if (hw_device_ctx) av_buffer_unref(&hw_device_ctx);
-        avcodec_free_context(&codecCtx);
-        avformat_close_input(&formatCtx);
+    // thread count from the shared budget, this session counts from now on
+    m_decoder_level = DECODE_LEVEL_FULL;
+    DecodePool::get().set_active(m_session, true);
+    m_codec_threads = DecodePool::get().threads(m_session);
+    m_codec_ctx = open_codec(m_codec_threads);
+    if (!m_codec_ctx) {
+        DecodePool::get().set_active(m_session, false);
+        if (m_hw_device_ctx) av_buffer_unref(&m_hw_device_ctx);
+        avcodec_parameters_free(&m_codec_par);
+        avformat_close_input(&m_format_ctx);
         throw std::runtime_error("Could not open codec for channel " + std::to_string(m_channel));
     }
 
-    // prepare frame/packet
-    AVPacket packet;
-    AVFrame* frame = av_frame_alloc();
-    if (!frame) {
-        if (hw_device_ctx) av_buffer_unref(&hw_device_ctx);
-        avcodec_free_context(&codecCtx);
-        avformat_close_input(&formatCtx);
+    // prepare frames
+    m_av_frame = av_frame_alloc();
+    m_hw_frame = av_frame_alloc();
+    if (!m_av_frame || !m_hw_frame) {
+        av_frame_free(&m_av_frame);
+        av_frame_free(&m_hw_frame);
+        DecodePool::get().set_active(m_session, false);
+        if (m_hw_device_ctx) av_buffer_unref(&m_hw_device_ctx);
+        avcodec_free_context(&m_codec_ctx);
+        avcodec_parameters_free(&m_codec_par);
+        avformat_close_input(&m_format_ctx);
         throw std::runtime_error("Failed to allocate AVFrame");
     }
 
-    // Cache sws context to avoid recreation per frame
-    SwsContext* swsCtx = nullptr;
-    int cached_w = 0, cached_h = 0;
-    AVPixelFormat cached_fmt = AV_PIX_FMT_NONE;
+    auto open_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - open_start).count();
+    std::cout << "connected: " << m_channel << " -- " << m_codec_ctx->width << "x" << m_codec_ctx->height
+              << " (" << m_codec_threads << " decode threads, " << open_ms << " ms" << (use_cache ? ", cached parameters" : "") << ")" << std::endl;
 
-    std::cout << "connected: " << m_channel << " -- " << codecCtx->width << "x" << codecCtx->height << std::endl;
+    m_frames_decoded = 0;
+    m_last_pts = AV_NOPTS_VALUE;
+    m_fps_start = std::chrono::high_resolution_clock::now();
+    return true;
+}
 
-    // prepare an output cv::Mat placeholder (will be resized per-frame if needed)
-    cv::Mat image_cpu;
+AVCodecContext* FrameReader::open_codec(int threads)
+{
+    const AVCodec* decoder = avcodec_find_decoder(m_codec_par->codec_id);
+    AVCodecContext* codecCtx = avcodec_alloc_context3(decoder);
+    if (!codecCtx) { return nullptr; }
+    avcodec_parameters_to_context(codecCtx, m_codec_par);
 
-    int i = 0;
-    int framesDecoded = 0;
-    auto start_time = std::chrono::high_resolution_clock::now();
-    int64_t last_pts = AV_NOPTS_VALUE;
+    // low-latency / threading hints
+    codecCtx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    // every extra frame thread is a frame of latency, so the count comes from the shared budget
+    codecCtx->thread_count = threads;
+    codecCtx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    codecCtx->skip_frame = decode_level_discard(m_decoder_level);
+    if (m_vectors) { codecCtx->flags2 |= AV_CODEC_FLAG2_EXPORT_MVS; } // AV_FRAME_DATA_MOTION_VECTORS side data
 
+    if (m_hw_device_ctx) {
+        codecCtx->hw_device_ctx = av_buffer_ref(m_hw_device_ctx);
+        codecCtx->get_format = get_vaapi_format;
+    }
 
-    // main loop
+    // codec options (don't set encoder-only options)
+    AVDictionary* codecOptions = nullptr;
+
+    // open codec
+    if (avcodec_open2(codecCtx, decoder, &codecOptions) < 0) {
+        avcodec_free_context(&codecCtx);
+        return nullptr;
+    }
+    return codecCtx;
+}
+
+void FrameReader::read_packets()
+{
+    // files are paced by their timestamps (unless unthrottled) and looped
+    bool is_file = m_input.type == INPUT_TYPE_FILE;
+    const double time_base = av_q2d(m_format_ctx->streams[m_video_stream]->time_base);
+    bool pace = is_file && m_input.realtime;
+    bool pace_set = false;
+    double pace_ts = 0;
+    std::chrono::steady_clock::time_point pace_start;
+
+    AVPacket* packet = av_packet_alloc();
+
+    // demux only, blocks in the kernel until the next packet arrives
     while (m_running) {
-        if (av_read_frame(formatCtx, &packet) < 0) {
-            // EOF or error: small sleep to avoid tight loop
-            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        int read_err = av_read_frame(m_format_ctx, packet);
+        if (read_err == AVERROR(EAGAIN)) { continue; }
+        if (read_err == AVERROR_EOF && is_file) {
+            // loop the file from the start, the decoder restarts when it gets there
+            if (av_seek_frame(m_format_ctx, m_video_stream, 0, AVSEEK_FLAG_BACKWARD) < 0) {
+                std::cerr << "Cannot seek to the start of the file for channel " << m_channel << std::endl;
+                break; // reopened like a lost stream
+            }
+            packet->stream_index = -1;
+            queue_packet(packet);
+            pace_set = false;
             continue;
         }
+        if (read_err < 0) {
+            // stream ended or broke, reconnect instead of polling a dead session
+            break;
+        }
 
-        if (packet.stream_index == videoStreamIndex) {
-            if (avcodec_send_packet(codecCtx, &packet) < 0) {
-                av_packet_unref(&packet);
-                continue;
-            }
+        if (packet->stream_index != m_video_stream) {
+            av_packet_unref(packet);
+            continue;
         }
-        av_packet_unref(&packet);
 
-        // Receive all available frames
-        while (avcodec_receive_frame(codecCtx, frame) == 0) {
-            // skip initial frames if needed to allow decoder warm-up
-            if (++framesDecoded < 5) {
-                av_frame_unref(frame);
-                continue;
+        int64_t ts = (packet->dts != AV_NOPTS_VALUE) ? packet->dts : packet->pts;
+        if (pace && ts != AV_NOPTS_VALUE) {
+            double t = ts * time_base;
+            if (!pace_set) {
+                pace_start = std::chrono::steady_clock::now();
+                pace_ts = t;
+                pace_set = true;
+            }
+            auto due = pace_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(t - pace_ts));
+            if (!wait_until(due)) {
+                av_packet_unref(packet);
+                break;
             }
+        }
 
-            // skip non-increasing PTS frames
-            if (last_pts != AV_NOPTS_VALUE && frame->pts <= last_pts) {
-                av_frame_unref(frame);
-                continue;
+        queue_packet(packet);
+    }
+
+    av_packet_free(&packet);
+}
+
+void FrameReader::queue_packet(AVPacket* packet)
+{
+    bool restart = packet->stream_index < 0; // file looped, flush the decoder
+    bool submit = false;
+    {
+        std::unique_lock<std::mutex> lock(m_packets_mtx);
+
+        if (m_backpressure) {
+            // every packet (and the loop marker) gets decoded, demuxing waits for room instead
+            m_packets_cv.wait(lock, [&] { return m_packets.size() < static_cast<size_t>(DECODE_QUEUE_SIZE) || !m_running; });
+            if (!m_running) {
+                av_packet_unref(packet);
+                return;
             }
-            last_pts = frame->pts;
-
-            // If this is a hardware frame (VAAPI), transfer it to a CPU-accessible frame
-            AVFrame* cpu_frame = nullptr;
-            if (frame->format == AV_PIX_FMT_VAAPI) {
-                cpu_frame = av_frame_alloc();
-                if (av_hwframe_transfer_data(cpu_frame, frame, 0) < 0) {
-                    av_frame_free(&cpu_frame);
-                    cpu_frame = nullptr; // fall back to using `frame` (software path) if transfer fails
-                }
+        }
+        else if (m_packets.size() >= static_cast<size_t>(DECODE_QUEUE_SIZE)) {
+            // decoding can't keep up, drop the backlog and resume at the next keyframe
+            m_packets_dropped += m_packets.size();
+            for (QueuedPacket& q : m_packets) {
+                av_packet_unref(q.packet);
+                m_free_packets.push_back(q.packet);
             }
+            m_packets.clear();
+            m_wait_key = true;
+        }
 
-            AVFrame* used_frame = cpu_frame ? cpu_frame : frame;
-
-            // width/height for convenience
-            int w = used_frame->width;
-            int h = used_frame->height;
-
-            // Update cached sws context if format/dimensions changed
-            if (!swsCtx || w != cached_w || h != cached_h || (AVPixelFormat)used_frame->format != cached_fmt) {
-                if (swsCtx) sws_freeContext(swsCtx);
-                swsCtx = sws_getContext(
-                    w, h, (AVPixelFormat)used_frame->format,
-                    w, h, AV_PIX_FMT_BGR24,
-                    SWS_BILINEAR, nullptr, nullptr, nullptr);
-                cached_w = w;
-                cached_h = h;
-                cached_fmt = (AVPixelFormat)used_frame->format;
+        if (!restart && m_wait_key) {
+            if (!(packet->flags & AV_PKT_FLAG_KEY)) {
+                m_packets_dropped++;
+                av_packet_unref(packet);
+                return;
             }
+            m_wait_key = false;
+        }
+
+        AVPacket* queued;
+        if (m_free_packets.empty()) { queued = av_packet_alloc(); }
+        else {
+            queued = m_free_packets.back();
+            m_free_packets.pop_back();
+        }
+        av_packet_move_ref(queued, packet);
+        m_packets.push_back({queued, std::chrono::steady_clock::now()});
+        m_queue_depth = static_cast<int>(m_packets.size());
+
+        if (!m_decode_scheduled) {
+            m_decode_scheduled = true;
+            submit = true;
+        }
+    }
 
-            if (swsCtx) {
-                // Create Mat, do sws_scale, then upload to UMat once
-                if (image_cpu.rows != h || image_cpu.cols != w) {
-                    image_cpu.create(h, w, CV_8UC3);
-                }
-                uint8_t* dst[1] = {image_cpu.data};
-                int dst_linesize[1] = {static_cast<int>(image_cpu.step[0])};
-                sws_scale(swsCtx, used_frame->data, used_frame->linesize, 0, h, dst, dst_linesize);
-
-                // Upload to GPU once
-                cv::UMat image_gpu;
-                image_cpu.copyTo(image_gpu);
-
-                m_frame_buffer.push(image_gpu);
-                m_frame_dbuffer.update(image_gpu);
-                m_active = true;
+    if (submit) { DecodePool::get().submit([this] { decode_pending(); }); }
+}
+
+void FrameReader::decode_pending()
+{
+    for (int i = 0; i < DECODE_BATCH; i++) {
+        QueuedPacket queued;
+        {
+            std::lock_guard<std::mutex> lock(m_packets_mtx);
+            if (m_packets.empty()) {
+                m_decode_scheduled = false;
+                m_packets_cv.notify_all();
+                return;
+            }
+            queued = m_packets.front();
+            m_packets.pop_front();
+            m_queue_depth = static_cast<int>(m_packets.size());
+        }
+        m_packets_cv.notify_all(); // room for a demux thread waiting on a full queue
+
+        auto start = std::chrono::steady_clock::now();
+        decode_packet(queued.packet, queued.received);
+        m_decode_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        m_decode_packets++;
+        av_packet_unref(queued.packet);
+
+        std::lock_guard<std::mutex> lock(m_packets_mtx);
+        m_free_packets.push_back(queued.packet);
+    }
+
+    // more may be queued, give the other readers a turn first
+    DecodePool::get().submit([this] { decode_pending(); });
+}
+
+void FrameReader::decode_packet(AVPacket* packet, std::chrono::steady_clock::time_point received)
+{
+    if (packet->stream_index < 0) {
+        avcodec_flush_buffers(m_codec_ctx);
+        m_last_pts = AV_NOPTS_VALUE;
+        return;
+    }
+
+    DECODE_LEVEL wanted = m_decode_level;
+    if (wanted != m_decoder_level) {
+        // dropping more is immediate, getting references back after
+        // keyframe only / paused decoding has to start at a keyframe
+        bool need_key = m_decoder_level >= DECODE_LEVEL_NONKEY && wanted < m_decoder_level;
+        if (!need_key || (packet->flags & AV_PKT_FLAG_KEY)) {
+            if (m_decoder_level == DECODE_LEVEL_PAUSED) { avcodec_flush_buffers(m_codec_ctx); }
+            m_codec_ctx->skip_frame = decode_level_discard(wanted);
+            m_decoder_level = wanted;
+            D(std::cout << "[" << m_channel << "] decode level " << m_decoder_level << std::endl);
+        }
+    }
+
+    if (m_decoder_level == DECODE_LEVEL_PAUSED) { return; }
+
+    // the budget moved (priorities or sessions changed) and stayed, restart the decoder at this keyframe.
+    // Channel switches, zooms and tour steps move it back and forth, those keep the decoder running.
+    if (packet->flags & AV_PKT_FLAG_KEY) {
+        int threads = DecodePool::get().threads(m_session);
+        auto now = std::chrono::steady_clock::now();
+        if (threads == m_codec_threads) {
+            m_threads_wanted = threads;
+        }
+        else if (threads != m_threads_wanted) {
+            m_threads_wanted = threads;
+            m_threads_wanted_since = now;
+        }
+        else if (now - m_threads_wanted_since >= std::chrono::milliseconds(DECODE_THREADS_SETTLE_MS)) {
+            AVCodecContext* codecCtx = open_codec(threads);
+            if (codecCtx) {
+                // frames still inside the frame threads come out before the new decoder starts
+                if (avcodec_send_packet(m_codec_ctx, nullptr) == 0) { receive_frames(received); }
+                avcodec_free_context(&m_codec_ctx);
+                m_codec_ctx = codecCtx;
+                m_codec_threads = threads;
+                D(std::cout << "[" << m_channel << "] decode threads " << threads << std::endl);
             }
             else {
-                std::cerr << "Failed to create sws context for channel " << m_channel << "." << std::endl;
+                std::cerr << "Failed to reopen decoder for channel " << m_channel << " with " << threads << " threads" << std::endl;
             }
+        }
+    }
+    if (avcodec_send_packet(m_codec_ctx, packet) < 0) { return; }
+    m_receive_times[m_receive_index++ % m_receive_times.size()] = {packet->pts, received};
+    receive_frames(received);
+}
 
-            // cleanup cpu_frame if allocated during hw transfer
-            if (cpu_frame) {
-                av_frame_free(&cpu_frame);
-            }
+// all frames the decoder has ready, `received` stands in for packets no longer in m_receive_times
+void FrameReader::receive_frames(std::chrono::steady_clock::time_point received)
+{
+    while (avcodec_receive_frame(m_codec_ctx, m_av_frame) == 0) {
+        auto decoded = std::chrono::steady_clock::now();
 
-            av_frame_unref(frame);
+        // skip initial frames if needed to allow decoder warm-up
+        if (++m_frames_decoded < 5) {
+            av_frame_unref(m_av_frame);
+            continue;
+        }
 
-            // FPS tracking (same as original logic)
-            i++;
-            if (i % 30 == 0) {
-                auto end_time = std::chrono::high_resolution_clock::now();
-                std::chrono::duration<double> elapsed = end_time - start_time;
-                double fps = 30.0 / elapsed.count();
-                captured_fps = fps;
-#ifdef DEBUG_FPS
-                if (i % 100 == 0) {
-                    std::cout << "Channel " << m_channel << " Frame Rate: " << fps << " FPS" << std::endl;
-                }
-#endif
-                start_time = std::chrono::high_resolution_clock::now();
+        // skip non-increasing PTS frames
+        if (m_last_pts != AV_NOPTS_VALUE && m_av_frame->pts <= m_last_pts) {
+            av_frame_unref(m_av_frame);
+            continue;
+        }
+        m_last_pts = m_av_frame->pts;
+
+        // frames come out reordered, find the packet this one started as
+        auto frame_received = received;
+        for (const auto& [pts, time] : m_receive_times) {
+            if (pts == m_av_frame->pts && pts != AV_NOPTS_VALUE) {
+                frame_received = time;
+                break;
             }
-        } // avcodec_receive_frame loop
-    } // main m_running loop
+        }
+
+        convert_frame(m_av_frame, frame_received, decoded);
+        av_frame_unref(m_av_frame);
+
+        update_fps();
+    }
+}
+
+void FrameReader::convert_frame(AVFrame* frame, std::chrono::steady_clock::time_point received, std::chrono::steady_clock::time_point decoded)
+{
+    // If this is a hardware frame (VAAPI), transfer it to a CPU-accessible frame
+    AVFrame* used_frame = frame; // fall back to `frame` (software path) if transfer fails
+    if (frame->format == AV_PIX_FMT_VAAPI && av_hwframe_transfer_data(m_hw_frame, frame, 0) == 0) {
+        used_frame = m_hw_frame;
+        m_hw_copies++;
+    }
+
+    // width/height for convenience
+    int w = used_frame->width;
+    int h = used_frame->height;
+
+    bool luma = m_luma && has_luma_plane((AVPixelFormat)used_frame->format);
+    bool bgr = m_bgr || !luma; // there is always something to show or detect on
+
+    // write straight into a recycled pool buffer, no per-frame allocation
+    std::shared_ptr<Frame> image = m_pool.acquire();
+    image->channel = m_channel;
+    image->pts = frame->pts;
+    image->received = received;
+    image->decoded = decoded;
+
+    if (luma) {
+        // Y plane as decoded, no colour conversion needed for detection
+        m_pool.create(image->luma, w, h, CV_8UC1);
+        cv::Mat y_plane(h, w, CV_8UC1, used_frame->data[0], used_frame->linesize[0]);
+        y_plane.copyTo(image->luma);
+    }
+    else {
+        image->luma.release();
+    }
+
+    if (m_vectors) { read_motion_vectors(frame, image->motion); }
+    else { image->motion.release(); }
+
+    if (bgr) {
+        // Update cached sws context if format/dimensions changed
+        if (!m_sws_ctx || w != m_sws_w || h != m_sws_h || used_frame->format != m_sws_fmt) {
+            if (m_sws_ctx) sws_freeContext(m_sws_ctx);
+            m_sws_ctx = sws_getContext(
+                w, h, (AVPixelFormat)used_frame->format,
+                w, h, AV_PIX_FMT_BGR24,
+                SWS_BILINEAR, nullptr, nullptr, nullptr);
+            m_sws_w = w;
+            m_sws_h = h;
+            m_sws_fmt = used_frame->format;
+        }
+
+        if (m_sws_ctx) {
+            m_pool.create(image->mat, w, h, CV_8UC3);
+            uint8_t* dst[1] = {image->mat.data};
+            int dst_linesize[1] = {static_cast<int>(image->mat.step[0])};
+            sws_scale(m_sws_ctx, used_frame->data, used_frame->linesize, 0, h, dst, dst_linesize);
+        }
+        else {
+            std::cerr << "Failed to create sws context for channel " << m_channel << "." << std::endl;
+            image->mat.release();
+        }
+    }
+    else {
+        image->mat.release();
+    }
+
+    if (!image->mat.empty() || !image->luma.empty()) {
+        publish(std::move(image));
+        m_active = true;
+    }
+
+    if (used_frame == m_hw_frame) { av_frame_unref(m_hw_frame); }
+}
+
+// the decoder's motion vectors as a grid of macroblocks, each keeps the longest vector that covers it
+void FrameReader::read_motion_vectors(const AVFrame* frame, cv::Mat& grid)
+{
+    const AVFrameSideData* side = av_frame_get_side_data(frame, AV_FRAME_DATA_MOTION_VECTORS);
+    if (!side) {
+        grid.release(); // keyframe, nothing was predicted
+        return;
+    }
+
+    int cols = (frame->width + MOTION_VECTOR_BLOCK - 1) / MOTION_VECTOR_BLOCK;
+    int rows = (frame->height + MOTION_VECTOR_BLOCK - 1) / MOTION_VECTOR_BLOCK;
+    m_pool.create(grid, cols, rows, CV_8UC1);
+    grid.setTo(0);
+
+    const AVMotionVector* vectors = reinterpret_cast<const AVMotionVector*>(side->data);
+    size_t count = side->size / sizeof(AVMotionVector);
+    for (size_t i = 0; i < count; i++) {
+        const AVMotionVector& mv = vectors[i];
+        int scale = mv.motion_scale > 0 ? mv.motion_scale : 1;
+        uint8_t length = cv::saturate_cast<uint8_t>(std::hypot(mv.motion_x, mv.motion_y) * MOTION_VECTOR_UNIT / scale);
+        if (length == 0) { continue; }
+
+        // partitions go down to 4x4, dst is the centre of the block in this frame
+        int x0 = std::max(0, (mv.dst_x - mv.w / 2) / MOTION_VECTOR_BLOCK);
+        int y0 = std::max(0, (mv.dst_y - mv.h / 2) / MOTION_VECTOR_BLOCK);
+        int x1 = std::min(cols - 1, (mv.dst_x + (mv.w - 1) / 2) / MOTION_VECTOR_BLOCK);
+        int y1 = std::min(rows - 1, (mv.dst_y + (mv.h - 1) / 2) / MOTION_VECTOR_BLOCK);
+        for (int y = y0; y <= y1; y++) {
+            uint8_t* row = grid.ptr<uint8_t>(y);
+            for (int x = x0; x <= x1; x++) { row[x] = std::max(row[x], length); }
+        }
+    }
+}
+
+void FrameReader::close_input()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_packets_mtx);
+        for (QueuedPacket& q : m_packets) {
+            av_packet_unref(q.packet);
+            m_free_packets.push_back(q.packet);
+        }
+        m_packets.clear();
+        m_queue_depth = 0;
+        m_wait_key = false;
+
+        // a worker may still be decoding a packet of this reader
+        m_packets_cv.wait(lock, [&] { return !m_decode_scheduled; });
+
+        for (AVPacket* p : m_free_packets) { av_packet_free(&p); }
+        m_free_packets.clear();
+    }
 
     m_active = false;
 
     // cleanup
-    if (swsCtx) sws_freeContext(swsCtx);
-    av_frame_free(&frame);
-    avcodec_free_context(&codecCtx);
-    if (hw_device_ctx) av_buffer_unref(&hw_device_ctx);
-    avformat_close_input(&formatCtx);
-
-    D(std::cout << "Exiting readFrames() thread for channel " << m_channel << std::endl);
+    if (m_sws_ctx) sws_freeContext(m_sws_ctx);
+    m_sws_ctx = nullptr;
+    m_sws_fmt = -1;
+    av_frame_free(&m_av_frame);
+    av_frame_free(&m_hw_frame);
+    avcodec_free_context(&m_codec_ctx);
+    avcodec_parameters_free(&m_codec_par);
+    if (m_hw_device_ctx) av_buffer_unref(&m_hw_device_ctx);
+    avformat_close_input(&m_format_ctx);
+    DecodePool::get().set_active(m_session, false);
+    m_codec_threads = 0;
 }
 
+
 void FrameReader::start()
 {
     if (!m_running && !m_cleaning) {
         m_running = true;
+        m_start_time = std::chrono::steady_clock::now();
+        m_first_frame_pending = true;
         m_thread = std::thread([this] { connect_and_read(); });
     }
 }
@@ -1,29 +1,43 @@
 #include "buffers.hpp"
+#include "decode_pool.hpp"
+#include "frame.hpp"
+#include "input_source.hpp"
+#include <array>
 #include <atomic>
 #include <condition_variable>
+#include <deque>
+#include <functional>
 #include <mutex>
 #include <opencv2/core/ocl.hpp>
 #include <opencv2/opencv.hpp>
 #include <string>
 #include <thread>
+#include <vector>
 
-// UMat-based double buffer
-class DoubleBufferUMat {
-  public:
-    void update(const cv::UMat& mat)
-    {
-        std::lock_guard<std::mutex> lock(m_mtx);
-        mat.copyTo(m_buffer);
-    }
-    cv::UMat get()
-    {
-        std::lock_guard<std::mutex> lock(m_mtx);
-        return m_buffer.clone();
-    }
+struct AVBufferRef;
+struct AVCodecContext;
+struct AVCodecParameters;
+struct AVFormatContext;
+struct AVFrame;
+struct AVPacket;
+struct SwsContext;
 
-  private:
-    cv::UMat m_buffer;
-    std::mutex m_mtx;
+// How much of the stream a reader decodes, channels that are not on screen can run cheaper
+enum DECODE_LEVEL {
+    DECODE_LEVEL_FULL,   // every frame
+    DECODE_LEVEL_NONREF, // drop non-reference frames, back to full immediately
+    DECODE_LEVEL_NONKEY, // keyframes only, back to full at the next keyframe
+    DECODE_LEVEL_PAUSED, // keep the session open but decode nothing
+};
+
+struct DecodeStats {
+    double decode_ms{0};     // average per packet, decoding and conversion
+    int queue_depth{0};      // packets waiting for a decode worker
+    int threads{0};          // codec threads from the DecodePool budget
+    uint64_t dropped{0};     // packets dropped because decoding fell behind
+    uint64_t produced{0};    // frames published
+    uint64_t consumed{0};    // frames taken by get_latest_frame(false)
+    uint64_t overwritten{0}; // frames replaced by a newer one before they were taken
 };
 
 class FrameReader {
@@ -33,10 +47,20 @@ class FrameReader {
                 const std::string& username,
                 const std::string& password,
                 int subtype,
+                const InputSource& input,
                 bool autostart,
                 bool has_placeholder);
 
-    cv::UMat get_latest_frame(bool no_empty_frame = false);
+    FramePtr get_latest_frame(bool no_empty_frame = false);
+    uint64_t get_generation();
+    void set_on_frame(std::function<void()> on_frame); // call before start()
+    void set_luma(bool luma);                          // also publish the Y plane (Frame::luma)
+    void set_bgr(bool bgr);                            // convert to BGR (Frame::mat), only skipped when luma is available
+    void set_motion_vectors(bool vectors);             // export the decoder's motion vectors (Frame::motion), call before start()
+    void set_decode_level(DECODE_LEVEL level);
+    DECODE_LEVEL get_decode_level();
+    void set_decode_priority(DECODE_PRIORITY priority);
+    DecodeStats get_decode_stats();
     double get_fps();
     void start();
     void stop();
@@ -45,8 +69,22 @@ class FrameReader {
 
   private:
     void connect_and_read();
+    bool open_input(const std::string& url); // false if the connection should be retried
+    void read_packets();                     // demux until stopped or the stream fails
+    void close_input();                      // waits for the decode worker to let go of this reader
+    void queue_packet(AVPacket* packet);     // takes the packet's reference, stamps its receive time, hands it to the decode pool
+    void decode_pending();                   // runs on a DecodePool worker
+    void decode_packet(AVPacket* packet, std::chrono::steady_clock::time_point received);
+    void receive_frames(std::chrono::steady_clock::time_point received);
+    AVCodecContext* open_codec(int threads); // nullptr on failure
+    void convert_frame(AVFrame* frame, std::chrono::steady_clock::time_point received, std::chrono::steady_clock::time_point decoded);
+    void read_motion_vectors(const AVFrame* frame, cv::Mat& grid);
+    void read_synthetic();
+    void update_fps();
+    bool wait_until(std::chrono::steady_clock::time_point deadline); // false if stopped meanwhile
     std::string construct_rtsp_url(const std::string& ip, const std::string& username, const std::string& password, int subtype);
     void put_placeholder();
+    void publish(std::shared_ptr<Frame> frame);
 
   private:
     std::thread m_thread;
@@ -55,14 +93,69 @@ class FrameReader {
     std::string m_password;
     int m_channel;
     int m_subtype;
+    InputSource m_input;
     std::atomic<double> captured_fps{15.0};
+    int m_fps_frames{0};
+    std::chrono::high_resolution_clock::time_point m_fps_start;
+    std::chrono::steady_clock::time_point m_start_time; // time to first frame is logged from here
+    std::atomic<bool> m_first_frame_pending{false};
 
     std::atomic<bool> m_sleep{true};
     std::mutex m_mtx;
     std::condition_variable m_cv;
 
-    LockFreeRingBuffer<cv::UMat, 2> m_frame_buffer;
-    DoubleBufferUMat m_frame_dbuffer;
+    FramePool m_pool;
+    FrameMailbox m_frame_mailbox;
+    uint64_t m_generation{0};
+    std::function<void()> m_on_frame;
+    std::atomic<bool> m_luma{false};
+    std::atomic<bool> m_bgr{true};
+    std::atomic<bool> m_vectors{false}; // software decoding, VAAPI frames carry no motion vectors
+    std::atomic<DECODE_LEVEL> m_decode_level{DECODE_LEVEL_FULL};
+    std::atomic<uint64_t> m_hw_copies{0};
+    int m_session; // DecodePool session of this reader
+    std::atomic<DECODE_PRIORITY> m_decode_priority{DECODE_PRIORITY_NORMAL};
+
+    // demux side, only touched by m_thread
+    AVFormatContext* m_format_ctx{nullptr};
+    int m_video_stream{-1};
+    bool m_backpressure{false}; // recorded input, queue_packet() waits for room instead of dropping
+
+    // decode side, only touched by the decode worker currently running this reader
+    AVCodecParameters* m_codec_par{nullptr}; // to reopen the decoder with a different thread count
+    AVCodecContext* m_codec_ctx{nullptr};
+    std::atomic<int> m_codec_threads{0};
+    int m_threads_wanted{0}; // budget share seen at the last keyframe, applied once it settled
+    std::chrono::steady_clock::time_point m_threads_wanted_since;
+    AVBufferRef* m_hw_device_ctx{nullptr};
+    AVFrame* m_av_frame{nullptr};
+    AVFrame* m_hw_frame{nullptr}; // reused target of VAAPI -> CPU transfers
+    SwsContext* m_sws_ctx{nullptr};
+    int m_sws_w{0};
+    int m_sws_h{0};
+    int m_sws_fmt{-1};
+    int m_frames_decoded{0};
+    int64_t m_last_pts{0};
+    DECODE_LEVEL m_decoder_level{DECODE_LEVEL_FULL}; // level the decoder is running at
+    std::array<std::pair<int64_t, std::chrono::steady_clock::time_point>, 32> m_receive_times; // pts -> packet receive time, decoder reorders
+    size_t m_receive_index{0};
+    int64_t m_decode_ns{0};                          // current fps window
+    int m_decode_packets{0};
+    std::atomic<double> m_decode_ms{0};
+
+    // packets handed from the demux thread to the decode pool (bounded)
+    std::mutex m_packets_mtx;
+    std::condition_variable m_packets_cv;
+    struct QueuedPacket {
+        AVPacket* packet;
+        std::chrono::steady_clock::time_point received;
+    };
+    std::deque<QueuedPacket> m_packets;
+    std::vector<AVPacket*> m_free_packets; // recycled AVPacket structs
+    bool m_decode_scheduled{false};        // queued on or running in the decode pool
+    bool m_wait_key{false};                // queue overflowed, drop until the next keyframe
+    std::atomic<uint64_t> m_packets_dropped{0};
+    std::atomic<int> m_queue_depth{0};
     cv::VideoCapture m_cap;
     std::atomic<bool> m_running{false};
     std::atomic<bool> m_cleaning{false};
@@ -77,10 +77,22 @@ inline constexpr int MOTION_DETECT_RECT_AREA = 0;
 inline constexpr int MOTION_DETECT_MIN_MS = 1000;
 inline constexpr int MOTION_DETECT_LINGER_MS = 3000; // after motion keep zoom for X ms
 inline constexpr int ENABLE_MOTION_ZOOM_LARGEST = 1;
+inline constexpr auto DETECT_ENGINE = "knn";    // knn, mog2, cnt, diff, ewma, mv
+inline constexpr int DETECT_HISTORY = 0;        // frames the background adapts over, 0 = engine default
+inline constexpr double DETECT_THRESHOLD = 0.0; // in the engine's own unit, 0 = engine default
+inline constexpr int DETECT_BLOBS = 0;          // connected components instead of contours
+inline constexpr int DETECT_ALLOC_WARMUP = 100; // debug_alloc: frames before allocations count as steady state
+inline constexpr int DETECT_ALLOC_CHECK = 500;  // debug_alloc: motion-free steady state frames the synthetic input checks
+inline constexpr int DETECT_IDLE_FPS = 5;       // detection rate once nothing moved for a while, 0 = every frame
+inline constexpr int DETECT_IDLE_S = 10;        // seconds without foreground before the idle rate
+inline constexpr int MOTION_VECTOR_BLOCK = 16;  // Frame::motion cell, one macroblock
+inline constexpr int MOTION_VECTOR_UNIT = 4;    // Frame::motion steps per pixel (quarter pixels)
 
 inline constexpr char SPLIT_COORD = 'x';
 inline constexpr char SPLIT_POINT = ' ';
 inline constexpr char SPLIT_LIST = ',';
+inline constexpr char SPLIT_MIN = ':';   // alarm zone minimum pixels before its points
+inline constexpr char SPLIT_FIELD = ':'; // focus target channel, area and sound
 
 // Ignore contours
 inline constexpr int ENABLE_IGNORE_CONTOURS = 1;
@@ -91,6 +103,9 @@ inline constexpr auto IGNORE_CONTOURS_FILENAME = "";
 inline constexpr int ENABLE_ALARM_PIXELS = 1;
 inline constexpr auto ALARM_PIXELS = "";
 inline constexpr auto ALARM_PIXELS_FILE = "";
+inline constexpr auto ALARM_ZONES = "";
+inline constexpr auto ALARM_ZONES_FILE = "";
+inline constexpr int ALARM_ZONE_MIN = 1; // foreground pixels inside a zone that trigger it
 
 // Tour & fullscreen
 inline constexpr int ENABLE_TOUR = 0;
@@ -99,6 +114,32 @@ inline constexpr int TOUR_MS = 3000;
 
 // Connection retries
 inline constexpr int CONN_RETRY_MS = 10000;
+inline constexpr int CONN_LOST_RETRY_MS = 1000; // first reopen after a lost stream, doubles up to CONN_RETRY_MS
+
+// Input (dahua, synthetic, file or url)
+inline constexpr auto INPUT = "dahua";
+inline constexpr int INPUT_REALTIME = 1;
+inline constexpr int SYNTHETIC_FPS = 25;
+inline constexpr int SYNTHETIC_GOP = 50; // keyframe interval the synthetic input emulates
+
+// Frame pool (recycled decode buffers per reader)
+inline constexpr int FRAME_POOL_SIZE = 6;
+inline constexpr int CACHE_LINE_SIZE = 64; // keeps producer and consumer state of shared buffers apart
+
+// Decoding (shared worker pool, readers only demux)
+inline constexpr int DECODE_WORKERS = 0;               // 0 = one per hardware thread
+inline constexpr int DECODE_THREADS = 0;               // codec thread budget shared by all readers, 0 = one per hardware thread
+inline constexpr int DECODE_THREADS_MAX = 16;          // per reader
+inline constexpr int DECODE_THREADS_SETTLE_MS = 10000; // a new budget share is applied once it held this long
+inline constexpr int DECODE_QUEUE_SIZE = 64;           // packets per reader before dropping to the next keyframe
+inline constexpr int DECODE_BATCH = 4;                 // packets a worker decodes before giving other readers a turn
+
+// Latency tracing
+inline constexpr int LATENCY_SAMPLES = 512; // per channel and stage, percentiles are over these
+inline constexpr int LATENCY_REPORT_S = 0;  // print percentiles every X seconds, 0 = off
+
+// Stream cache (codec parameters of known streams, skips probing on startup)
+inline constexpr auto STREAM_CACHE = "";
 
 // Window defaults
 inline constexpr int DEFAULT_WIDTH = static_cast<int>(W_HD * 0.8);
@@ -110,6 +151,8 @@ inline constexpr auto DEFAULT_WINDOW_NAME = "Motion";
 inline constexpr int FOCUS_CHANNEL = -1;
 inline constexpr auto FOCUS_CHANNEL_AREA = "";
 inline constexpr int FOCUS_CHANNEL_SOUND = 0;
+inline constexpr auto FOCUS_TARGETS = "";
+inline constexpr int FOCUS_DETECT_WIDTH = 0; // detection width cap in focus mode, 0 = native (at most the window)
 
 // low CPU mode
 inline constexpr int LOW_CPU_MODE = 0;
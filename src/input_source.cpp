@@ -0,0 +1,100 @@
+#include "input_source.hpp"
+#include "globals.hpp"
+#include <cmath>
+#include <string>
+
+// e.g. "dahua", "synthetic", "file:videos/ch{ch}.mp4", "videos/ch{ch}.mp4", "rtsp://host/stream{ch}"
+InputSource InputSource::parse(const std::string& input, bool realtime)
+{
+    InputSource source;
+    source.realtime = realtime;
+
+    if (input.empty() || input == "dahua") {
+        source.type = INPUT_TYPE_DAHUA;
+    }
+    else if (input == "synthetic") {
+        source.type = INPUT_TYPE_SYNTHETIC;
+    }
+    else if (input.rfind("file:", 0) == 0) {
+        source.type = INPUT_TYPE_FILE;
+        source.location = input.substr(5);
+    }
+    else if (input.find("://") != std::string::npos) {
+        source.type = INPUT_TYPE_URL;
+        source.location = input;
+    }
+    else {
+        source.type = INPUT_TYPE_FILE;
+        source.location = input;
+    }
+
+    return source;
+}
+
+std::string InputSource::resolve(int channel) const
+{
+    std::string resolved = location;
+    const std::string key = "{ch}";
+    size_t pos;
+    while ((pos = resolved.find(key)) != std::string::npos) {
+        resolved.replace(pos, key.size(), std::to_string(channel));
+    }
+    return resolved;
+}
+
+void render_synthetic(cv::Mat& dst, int channel, uint64_t index)
+{
+    const int w = dst.cols;
+    const int h = dst.rows;
+    const double t = static_cast<double>(index) / SYNTHETIC_FPS;
+
+    // lighting steps every 10 seconds, different per channel
+    int light = 50 + 40 * static_cast<int>((index / (SYNTHETIC_FPS * 10) + channel) % 3);
+    dst.setTo(cv::Scalar(light, light, light));
+
+    // static structure for the background model
+    for (int i = 1; i < 4; i++) {
+        cv::line(dst, cv::Point(i * w / 4, 0), cv::Point(i * w / 4, h - 1), cv::Scalar(light + 40, light + 30, light + 20), std::max(1, w / 200));
+    }
+    cv::rectangle(dst, cv::Rect(w / 10, h * 2 / 3, w / 5, h / 4), cv::Scalar(light / 2, light, light + 60), cv::FILLED);
+
+    // moving shapes, active 8 seconds out of 20 so there are quiet periods as well
+    if (std::fmod(t + channel * 2.5, 20.0) < 8.0) {
+        double phase = channel * 0.7;
+        cv::Rect box(static_cast<int>((0.5 + 0.4 * std::sin(t * 0.9 + phase)) * w) - w / 20,
+                     static_cast<int>((0.35 + 0.1 * std::cos(t * 0.5 + phase)) * h) - h / 16,
+                     w / 10, h / 8);
+        cv::rectangle(dst, box, cv::Scalar(30, 30, 200), cv::FILLED);
+
+        cv::Point center(static_cast<int>(std::fmod(t * 0.15 + channel * 0.1, 1.0) * w),
+                         static_cast<int>((0.6 + 0.25 * std::sin(t * 1.3 + phase)) * h));
+        cv::circle(dst, center, std::max(2, h / 14), cv::Scalar(200, 180, 40), cv::FILLED);
+    }
+
+    // sensor noise, seeded by channel and frame so every run is identical
+    cv::RNG rng(static_cast<uint64_t>(channel) * 1000003ULL + index);
+    int speckles = w * h / 200;
+    for (int i = 0; i < speckles; i++) {
+        int x = rng.uniform(0, w);
+        int y = rng.uniform(0, h);
+        uchar v = static_cast<uchar>(rng.uniform(0, 256));
+        dst.at<cv::Vec3b>(y, x) = cv::Vec3b(v, v, v);
+    }
+
+    cv::putText(dst, std::to_string(channel), cv::Point(w / 40 + 2, h / 8), cv::FONT_HERSHEY_SIMPLEX,
+                std::max(0.3, h / 400.0), cv::Scalar(255, 255, 255), std::max(1, h / 300));
+}
+
+void render_synthetic_mosaic(cv::Mat& dst, uint64_t index)
+{
+    const int tile_w = dst.cols / 3;
+    const int tile_h = dst.rows / 3;
+
+    dst.setTo(cv::Scalar(0, 0, 0));
+    for (int ch = 1; ch <= CHANNEL_COUNT; ch++) {
+        int row = (ch - 1) / 3;
+        int col = (ch - 1) % 3;
+        cv::Mat tile = dst(cv::Rect(col * tile_w, row * tile_h, tile_w, tile_h));
+        render_synthetic(tile, ch, index);
+    }
+}
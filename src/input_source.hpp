@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include <string>
+
+enum INPUT_TYPE {
+    INPUT_TYPE_DAHUA,     // rtsp url built from ip, username, password and subtype
+    INPUT_TYPE_URL,       // any url ffmpeg can open
+    INPUT_TYPE_FILE,      // local video file, looped
+    INPUT_TYPE_SYNTHETIC, // deterministic generated scene, no ffmpeg
+};
+
+// Where a FrameReader gets its frames from.
+// `location` may contain {ch} which is replaced with the channel number.
+struct InputSource {
+    INPUT_TYPE type{INPUT_TYPE_DAHUA};
+    std::string location;
+    bool realtime{true}; // files and synthetic input: pace to real time, otherwise as fast as possible
+
+    static InputSource parse(const std::string& input, bool realtime);
+    std::string resolve(int channel) const;
+};
+
+// Synthetic scene of a single channel, drawn to fit `dst` (may be a ROI).
+void render_synthetic(cv::Mat& dst, int channel, uint64_t index);
+// Channel 0 style 3x3 mosaic of the channel scenes.
+void render_synthetic_mosaic(cv::Mat& dst, uint64_t index);
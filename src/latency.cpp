@@ -0,0 +1,77 @@
+#include "latency.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+static const char* stage_name(LATENCY_STAGE stage)
+{
+    switch (stage) {
+        case LATENCY_STAGE_DECODE:  return "decode";
+        case LATENCY_STAGE_CONVERT: return "convert";
+        case LATENCY_STAGE_DETECT:  return "detect";
+        case LATENCY_STAGE_DISPLAY: return "display";
+        case LATENCY_STAGE_TOTAL:   return "total";
+        default:                    return "?";
+    }
+}
+
+LatencyTracker& LatencyTracker::get()
+{
+    static LatencyTracker tracker;
+    return tracker;
+}
+
+void LatencyTracker::record(int channel, LATENCY_STAGE stage, std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+{
+    using clock = std::chrono::steady_clock;
+    if (from == clock::time_point() || to == clock::time_point() || to < from) { return; }
+    if (channel < 0 || channel > CHANNEL_COUNT) { return; }
+
+    float ms = std::chrono::duration<float, std::milli>(to - from).count();
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+    Samples& samples = m_samples[channel][stage];
+    samples.ms[samples.count % LATENCY_SAMPLES] = ms;
+    samples.count++;
+}
+
+LatencyPercentiles LatencyTracker::percentiles(int channel, LATENCY_STAGE stage)
+{
+    std::vector<float> sorted;
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        const Samples& samples = m_samples[channel][stage];
+        sorted.assign(samples.ms.begin(), samples.ms.begin() + std::min<size_t>(samples.count, LATENCY_SAMPLES));
+    }
+
+    LatencyPercentiles result;
+    result.samples = sorted.size();
+    if (sorted.empty()) { return result; }
+
+    std::sort(sorted.begin(), sorted.end());
+    auto at = [&](double p) { return sorted[static_cast<size_t>(p * (sorted.size() - 1))]; };
+    result.p50 = at(0.50);
+    result.p95 = at(0.95);
+    result.p99 = at(0.99);
+    return result;
+}
+
+// one line per channel, stages without samples are left out
+void LatencyTracker::print()
+{
+    std::cout << "Latency ms (p50/p95/p99):" << std::endl;
+    for (int ch = 0; ch <= CHANNEL_COUNT; ch++) {
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(1);
+        for (int stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+            LatencyPercentiles p = percentiles(ch, static_cast<LATENCY_STAGE>(stage));
+            if (!p.samples) { continue; }
+            line << "  " << stage_name(static_cast<LATENCY_STAGE>(stage)) << " " << p.p50 << "/" << p.p95 << "/" << p.p99;
+        }
+        if (!line.str().empty()) {
+            std::cout << "  channel " << ch << ":" << line.str() << std::endl;
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+
+#include "globals.hpp"
+
+enum LATENCY_STAGE {
+    LATENCY_STAGE_DECODE,  // packet received -> decoder output (queue wait and decoding)
+    LATENCY_STAGE_CONVERT, // decoder output -> published (luma copy, BGR conversion)
+    LATENCY_STAGE_DETECT,  // published -> motion detection done
+    LATENCY_STAGE_DISPLAY, // published -> shown
+    LATENCY_STAGE_TOTAL,   // packet received -> shown
+    LATENCY_STAGE_COUNT,
+};
+
+struct LatencyPercentiles {
+    double p50{0}; // ms
+    double p95{0};
+    double p99{0};
+    size_t samples{0};
+};
+
+// Stage latencies per channel, the last LATENCY_SAMPLES of every stage.
+// Process wide, recorded by the readers, the detection thread and the draw loop.
+class LatencyTracker {
+  public:
+    static LatencyTracker& get();
+
+    // ignored if either stamp was never set
+    void record(int channel, LATENCY_STAGE stage, std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to);
+    LatencyPercentiles percentiles(int channel, LATENCY_STAGE stage);
+    void print();
+
+  private:
+    LatencyTracker() = default;
+
+    struct Samples {
+        std::array<float, LATENCY_SAMPLES> ms;
+        size_t count{0};
+    };
+
+  private:
+    std::mutex m_mtx;
+    std::array<std::array<Samples, LATENCY_STAGE_COUNT>, CHANNEL_COUNT + 1> m_samples;
+};
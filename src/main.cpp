@@ -36,6 +36,7 @@ int main(int argc, char* argv[])
 #endif
 
     init_signal();
+    D_ALLOC(install_mat_alloc_counter());
 
 #ifdef DEBUG_CPU
     CpuUsageMonitor monitor;
@@ -55,6 +56,10 @@ int main(int argc, char* argv[])
 
     uninit_sound();
 
+#ifdef DEBUG_ALLOC
+    if (motionDetector->alloc_check() > 0) { return 1; } // frames without motion allocated
+#endif
+
     DPL("main return 0");
     return 0;
 }
@@ -1,24 +1,29 @@
 #include "motion_detector.hpp"
 #include "debug.hpp"
+#include "decode_pool.hpp"
+#include "stream_cache.hpp"
 #include "globals.hpp"
 #include "opencv2/highgui.hpp"
 #include <SDL2/SDL_mixer.h>
 #include <argparse/argparse.hpp>
 #include <iostream>
-#include <opencv2/bgsegm.hpp>
 #include <opencv2/opencv.hpp>
 #include <string>
 #include <sys/types.h>
 #include <unistd.h>
 
 MotionDetector::MotionDetector(const MotionDetectorParams& params)
-    : m_subtype(params.subtype),
+    : m_input(InputSource::parse(params.input, params.input_realtime)),
+      m_subtype(params.subtype),
       m_display_width(params.width),
       m_display_height(params.height),
       m_fullscreen(params.fullscreen),
       m_display_mode(params.display_mode),
       m_motion_min_area(params.area),
       m_motion_min_rect_area(params.rarea),
+      m_detect_blobs(params.detect_blobs),
+      m_detect_idle_fps(params.detect_idle_fps),
+      m_detect_idle_s(params.detect_idle_s),
       m_motion_detect_min_ms(params.motion_detect_min_ms),
       m_tour_ms(params.tour_ms),
       m_low_cpu(params.low_cpu),
@@ -37,14 +42,13 @@ MotionDetector::MotionDetector(const MotionDetectorParams& params)
       m_enable_ignore_contours(params.enable_ignore_contours),
       m_enable_alarm_pixels(params.enable_alarm_pixels),
       m_focus_channel(params.focus_channel),
-      m_focus_channel_sound(params.focus_channel_sound),
+      m_focus_detect_width(params.focus_detect_width),
       m_canv1(cv::UMat(cv::Size(params.width, params.height), CV_8UC3, cv::Scalar(0, 0, 0))),
       m_canv2(cv::UMat(cv::Size(params.width, params.height), CV_8UC3, cv::Scalar(0, 0, 0))),
       m_main_display(cv::UMat(cv::Size(params.width, params.height), CV_8UC3, cv::Scalar(0, 0, 0))),
       m_sleep_ms_draw(params.sleep_ms_draw),
       m_sleep_ms_draw_auto(params.sleep_ms_draw_auto),
-      m_sleep_ms_motion(params.sleep_ms_motion),
-      m_sleep_ms_motion_auto(params.sleep_ms_motion_auto)
+      m_latency_report_s(params.latency_report)
 {
     // Check OpenCL availability
     if (cv::ocl::haveOpenCL()) {
@@ -58,17 +62,43 @@ MotionDetector::MotionDetector(const MotionDetectorParams& params)
 
     init_ignore_contours(params);
     init_alarm_pixels(params);
+    m_drawn_frames.reserve(CHANNEL_COUNT + 1);
+    m_tile_placements.reserve(CHANNEL_COUNT);
 
-    // m_fgbg = cv::createBackgroundSubtractorMOG2(20, 32, true);
-    m_fgbg = cv::createBackgroundSubtractorKNN(20, 400.0, true);
-    // m_fgbg = cv::bgsegm::createBackgroundSubtractorCNT(true, 15, true);
+    // before any reader starts, they all decode on this pool
+    DecodePool::get().start(params.decode_workers);
+    DecodePool::get().set_thread_budget(params.decode_threads);
+    StreamCache::get().open(params.stream_cache);
+
+    m_detect_engine_params = {params.detect_engine, params.detect_history, params.detect_threshold};
+    m_detect_vectors = params.detect_engine == DETECT_ENGINE_MV;
+    D_CPU(m_engine_bench = std::make_unique<DetectEngineBench>(m_detect_engine_params));
+
+    bool focus = params.focus_channel != -1 || !params.focus_targets.empty();
 
     // clang-format off
-    if      (params.low_cpu)             { init_lowcpu(params);  m_thread_ch0 = std::thread([this]() { update_ch0(); }); }
-    else if (params.focus_channel == -1) { init_default(params); m_thread_ch0 = std::thread([this]() { update_ch0(); }); }
-    else if (params.focus_channel != -1) { init_focus(params);                                                           }
+    if      (params.low_cpu) { init_lowcpu(params);  }
+    else if (!focus)         { init_default(params); }
+    else                     { init_focus(params);   }
     // clang-format on
 
+    // the detection readers wake the detection thread on every new frame,
+    // in focus mode only the targets' readers run
+    m_detect_channel = m_focus_targets.empty() ? 0 : m_focus_targets[0].channel;
+    update_reader_outputs();
+    update_decode_levels();
+    if (m_focus_targets.empty()) {
+        m_readers[m_detect_channel]->set_on_frame([this]() { notify_detection(); });
+        m_readers[m_detect_channel]->set_motion_vectors(m_detect_vectors);
+        m_readers[m_detect_channel]->start();
+    }
+    for (const FocusTarget& target : m_focus_targets) {
+        if (m_readers[target.channel]->is_running()) { continue; } // same channel, other area
+        m_readers[target.channel]->set_on_frame([this]() { notify_detection(); });
+        m_readers[target.channel]->set_motion_vectors(m_detect_vectors);
+        m_readers[target.channel]->start();
+    }
+
     m_thread_detect_motion = std::thread([this]() { detect_motion(); });
 }
 
@@ -77,6 +107,7 @@ void MotionDetector::init_ignore_contours(const MotionDetectorParams& params)
     if (!params.ignore_contours.empty()) parse_ignore_contours(params.ignore_contours);
     if (!params.ignore_contours_file.empty()) parse_ignore_contours_file(params.ignore_contours_file);
     print_ignore_contours();
+    update_ignore_mask();
 }
 
 void MotionDetector::init_alarm_pixels(const MotionDetectorParams& params)
@@ -84,13 +115,18 @@ void MotionDetector::init_alarm_pixels(const MotionDetectorParams& params)
     if (!params.alarm_pixels.empty()) parse_alarm_pixels(params.alarm_pixels);
     if (!params.alarm_pixels_file.empty()) parse_alarm_pixels_file(params.alarm_pixels_file);
     print_alarm_pixels();
+
+    m_alarm_zone_min = std::max(1, params.alarm_zone_min);
+    if (!params.alarm_zones.empty()) parse_alarm_zones(params.alarm_zones);
+    if (!params.alarm_zones_file.empty()) parse_alarm_zones_file(params.alarm_zones_file);
+    update_alarm_zones();
 }
 
 void MotionDetector::init_default(const MotionDetectorParams& params)
 {
-    m_readers.emplace_back(std::make_unique<FrameReader>(0, params.ip, params.username, params.password, params.subtype, true, true));
+    m_readers.emplace_back(std::make_unique<FrameReader>(0, params.ip, params.username, params.password, params.subtype, m_input, false, true));
     for (int channel = 1; channel <= CHANNEL_COUNT; ++channel) {
-        m_readers.emplace_back(std::make_unique<FrameReader>(channel, params.ip, params.username, params.password, params.subtype, true, true));
+        m_readers.emplace_back(std::make_unique<FrameReader>(channel, params.ip, params.username, params.password, params.subtype, m_input, true, true));
     }
 
     change_channel(params.current_channel);
@@ -98,33 +134,50 @@ void MotionDetector::init_default(const MotionDetectorParams& params)
 
 void MotionDetector::init_lowcpu(const MotionDetectorParams& params)
 {
-    m_readers.emplace_back(std::make_unique<FrameReader>(0, params.ip, params.username, params.password, params.subtype, true, false));
+    m_readers.emplace_back(std::make_unique<FrameReader>(0, params.ip, params.username, params.password, params.subtype, m_input, false, false));
     for (int channel = 1; channel <= CHANNEL_COUNT; ++channel) {
-        m_readers.emplace_back(std::make_unique<FrameReader>(channel, params.ip, params.username, params.password, params.subtype, false, false));
+        m_readers.emplace_back(std::make_unique<FrameReader>(channel, params.ip, params.username, params.password, params.subtype, m_input, false, false));
     }
 
     change_channel(params.current_channel);
     m_motion_region_info_rect_width = 1;
+
+    // HD sessions are opened once, switching channels only changes what they decode
+    if (m_low_cpu_hq_motion) {
+        update_decode_levels();
+        for (int channel = 1; channel <= CHANNEL_COUNT; ++channel) { m_readers[channel]->start(); }
+    }
 }
 
 void MotionDetector::init_focus(const MotionDetectorParams& params)
 {
+    // no placeholder, a 1000x1000 one would size the focus layout, tiles and masks until the stream arrives
     for (int channel = 0; channel <= CHANNEL_COUNT; channel++) {
-        m_readers.emplace_back(std::make_unique<FrameReader>(channel, params.ip, params.username, params.password, params.subtype, channel == params.focus_channel, true));
+        m_readers.emplace_back(std::make_unique<FrameReader>(channel, params.ip, params.username, params.password, params.subtype, m_input, false, false));
+    }
+
+    // -fc/-fca/-fcs is the first target
+    if (params.focus_channel != -1) {
+        FocusTarget target{params.focus_channel, cv::Rect(), params.focus_channel_sound != 0};
+        if (!params.focus_channel_area.empty() && params.focus_channel_area != "") {
+            auto [x, y, w, h] = parse_area(params.focus_channel_area);
+            target.area = cv::Rect(x, y, w, h);
+        }
+        m_focus_targets.push_back(target);
+    }
+    if (!params.focus_targets.empty()) { parse_focus_targets(params.focus_targets); }
+
+    if (m_focus_targets.empty()) {
+        std::cerr << "Error: no valid focus target" << std::endl;
+        std::exit(1);
     }
+    m_focus_channel = m_focus_targets[0].channel;
 
-    if (!params.focus_channel_area.empty() && params.focus_channel_area != "") {
-        auto [x, y, w, h] = parse_area(params.focus_channel_area);
-        m_focus_channel_area_x = x;
-        m_focus_channel_area_y = y;
-        m_focus_channel_area_w = w;
-        m_focus_channel_area_h = h;
-        m_focus_channel_area_set = true;
-        D(std::cout << "focus channel area: "
-                    << m_focus_channel_area_x << "x"
-                    << m_focus_channel_area_y << ";"
-                    << m_focus_channel_area_w << "x"
-                    << m_focus_channel_area_h << std::endl;);
+    for (const FocusTarget& target : m_focus_targets) {
+        D(std::cout << "focus target: channel " << target.channel << " area "
+                    << target.area.x << "x" << target.area.y << ";"
+                    << target.area.width << "x" << target.area.height
+                    << " sound " << target.sound << std::endl;);
     }
 }
 
@@ -133,10 +186,10 @@ void MotionDetector::stop()
     std::cout << "\n\nQuitting..." << std::endl;
     m_running = false;
     m_cv_draw.notify_one();
-    m_cv_motion.notify_one();
+    notify_detection();
     if (m_thread_detect_motion.joinable()) { m_thread_detect_motion.join(); }
-    if (m_thread_ch0.joinable()) { m_thread_ch0.join(); }
     for (auto& reader : m_readers) { reader->stop(); }
+    DecodePool::get().stop(); // readers are closed, nothing is decoding any more
     D(std::cout << "destroy all win" << std::endl);
     cv::destroyAllWindows();
     D(std::cout << "destroy all win done" << std::endl);
@@ -1,14 +1,15 @@
 #pragma once
 #include <argparse/argparse.hpp>
+#include <array>
 #include <atomic>
 #include <condition_variable>
 #include <mutex>
-#include <opencv2/bgsegm.hpp>
 #include <opencv2/opencv.hpp>
 #include <string>
 #include <vector>
 
 #include "buffers.hpp"
+#include "detector_engine.hpp"
 #include "frame_reader.hpp"
 
 #include "globals.hpp"
@@ -22,7 +23,8 @@ class MotionDetector {
 
     void draw_loop();
     void stop();
-    DoubleBuffer<cv::Point> m_mouse_pos;
+    int alloc_check() const { return m_alloc_check; } // debug_alloc: -1 running, 0 passed, 1 motion-free frames allocated
+    SeqLock<cv::Point> m_mouse_pos;
 
   private:
     void init_default(const MotionDetectorParams& params);
@@ -33,10 +35,18 @@ class MotionDetector {
     void init_alarm_pixels(const MotionDetectorParams& params);
 
     void detect_motion();
-    void update_ch0();
+    void notify_detection();
+    bool focus_frames_pending();
+    bool take_focus_frames();   // false if no target has a new frame
+    bool prepare_focus_frame(); // the targets' areas side by side
+    bool update_focus_layout(); // true if a target moved or changed size
     void detect_largest_motion_area_set_channel();
+    void update_detect_tiles(const cv::Size& size);
+    void update_detect_rate(double cpu_ms);
 
     void change_channel(int ch);
+    void update_reader_outputs();
+    void update_decode_levels();
     void do_tour_logic();
 
     void draw_loop_handle_keys();
@@ -45,27 +55,40 @@ class MotionDetector {
     void draw_paint_info_text();
     void draw_paint_info_line();
     void draw_paint_info_motion_region(cv::UMat& canv, size_t posX, size_t posY, size_t width, size_t height);
+    void draw_paint_detection_rects(const Frame& frame); // focus frame rectangles, scaled to the window
 
     cv::UMat draw_paint_main_mat_all();
     cv::UMat draw_paint_main_mat_sort();
     cv::UMat draw_paint_main_mat_multi();
     cv::UMat draw_paint_main_mat_king();
     cv::UMat draw_paint_main_mat_top();
+    void draw_paint_tiles(cv::UMat& canvas, int layout); // renders m_tile_placements
 
     void parse_ignore_contours(const std::string& input);
     void parse_ignore_contours_file(const std::string& filename);
     void print_ignore_contours();
+    void update_ignore_mask(); // after the ignore contours changed
+    cv::Size rasterise_size(); // detection frame size the ignore area and alarm zones are rasterised at
+    cv::Size focus_detect_size(const cv::Size& roi, const cv::Size& cell);
 
     void parse_alarm_pixels(const std::string& input);
     void parse_alarm_pixels_file(const std::string& filename);
     void print_alarm_pixels();
+    void parse_alarm_zones(const std::string& input);
+    void parse_alarm_zones_file(const std::string& filename);
+    void parse_alarm_zone(const std::string& zone); // one "[min:]<x>x<y> ..." polygon
+    void update_alarm_zones();                      // after the alarm pixels changed
 
     std::tuple<long, long, long, long> parse_area(const std::string& input);
+    void parse_focus_targets(const std::string& input);
 
-    cv::UMat get_frame(int channel, int layout_changed);
+    cv::Mat get_frame(int channel, int layout_changed, FramePtr& hold);
+    void mark_drawn(const FramePtr& frame); // part of the image being composed
+    void record_drawn();                    // the composed image was just shown
 
     std::atomic<bool> m_running{true};
 
+    InputSource m_input;
     int m_subtype;
     int m_display_width;
     int m_display_height;
@@ -73,6 +96,9 @@ class MotionDetector {
     std::atomic<int> m_display_mode;
     int m_motion_min_area;
     int m_motion_min_rect_area;
+    bool m_detect_blobs;
+    int m_detect_idle_fps;
+    int m_detect_idle_s;
     int m_motion_detect_min_ms;
     int m_tour_ms;
     int m_low_cpu;
@@ -80,6 +106,7 @@ class MotionDetector {
     int m_low_cpu_hq_motion_dual;
     std::atomic<int> m_current_channel;
     std::atomic<int> m_previous_channel{-1};
+    std::array<std::atomic<uint64_t>, CHANNEL_COUNT + 1> m_hq_paused_generation{}; // low_cpu_hq: last frame before the reader was paused
     std::atomic<bool> m_enable_motion;
     std::atomic<bool> m_enable_motion_zoom_largest;
     std::atomic<bool> m_enable_tour;
@@ -92,31 +119,117 @@ class MotionDetector {
     std::atomic<bool> m_enable_ignore_contours;
     std::atomic<bool> m_enable_alarm_pixels;
     std::atomic<int> m_focus_channel{FOCUS_CHANNEL};
-    std::atomic<bool> m_focus_channel_area_set;
-    std::atomic<long> m_focus_channel_area_x;
-    std::atomic<long> m_focus_channel_area_y;
-    std::atomic<long> m_focus_channel_area_w;
-    std::atomic<long> m_focus_channel_area_h;
-    std::atomic<int> m_focus_channel_sound;
+    int m_focus_detect_width;
+    SeqLock<cv::Size> m_focus_detect_size; // focus frames are detected at their own size, published by the detection thread
+    cv::Size m_rasterised_size;            // draw thread, detection size the ignore mask and alarm zones were made for
+
+    // focus mode watches these areas, each its own reader and tile of the detection frame,
+    // fixed at startup, the frame state belongs to the detection thread
+    struct FocusTarget {
+        int channel;
+        cv::Rect area; // in the channel's frame, empty = all of it
+        bool sound;    // play the alarm when motion is detected here
+
+        FramePtr frame; // latest taken
+        uint64_t generation{0};
+        bool fresh{false}; // new frame since the last detection
+        cv::Rect roi;      // area clipped to the frame
+        cv::Rect rect;     // in the detection frame
+    };
+    std::vector<FocusTarget> m_focus_targets; // empty if not in focus mode, else m_focus_channel is the first one
+    bool m_focus_layout_changed{false};
+    cv::Size m_focus_frame_size; // grid of the targets
 
     // init
-    std::thread m_thread_ch0;
     std::thread m_thread_detect_motion;
     std::vector<std::unique_ptr<FrameReader>> m_readers;
-    // cv::Ptr<cv::BackgroundSubtractorMOG2> m_fgbg;     // 69.6
-    cv::Ptr<cv::BackgroundSubtractorKNN> m_fgbg; // 69% KNN
-    // cv::Ptr<cv::bgsegm::BackgroundSubtractorCNT> m_fgbg; // 62% CNT
-
-    cv::UMat m_frame0;
-    DoubleBufferUMat m_frame0_dbuff; // Need to add this class or reuse from frame_reader.hpp
-    cv::UMat m_frame_detection;
-    DoubleBufferUMat m_frame_detection_dbuff;
+
+    // the channel 0 mosaic is detected per channel tile, concurrently, each tile with its own
+    // background model so a lighting change in one camera does not affect the others
+    struct DetectTile {
+        int channel;   // mosaic channel, the focus channel for a whole frame
+        cv::Rect rect; // in the detection frame
+        std::unique_ptr<DetectorEngine> engine;
+        int min_area;
+        int min_rect_area;
+        bool blobs;        // connected components stats instead of contours
+        bool sound{false}; // focus target alarm
+        bool skip{false};  // focus target without a new frame, keeps its last result
+
+        // result of the last frame, detection frame coordinates
+        int changed{0}; // foreground pixels
+        bool detected{false};
+        cv::Rect motion_region; // largest
+        double max_area{0};
+        std::vector<std::vector<cv::Point>> contours; // blobs: only traced for the overlay
+        std::vector<cv::Rect> rects;                  // contours above the thresholds
+
+        cv::Mat mask; // foreground
+        cv::Mat labels;
+        cv::Mat stats;
+        cv::Mat centroids;
+        cv::Mat blob; // one label, to trace its outline
+        std::vector<std::vector<cv::Point>> blob_contours;
+
+        void detect(const cv::Mat& frame, const cv::Mat& ignore, bool outline);
+
+      private:
+        void find_contours();
+        void find_blobs(bool outline);
+        void add_region(const cv::Rect& bounds);
+    };
+    std::vector<DetectTile> m_detect_tiles;
+
+    // alarm zone rasterised into a mask over its bounding rect, a polygon or the alarm pixels,
+    // triggers when enough foreground of any tile falls into it
+    struct AlarmZone {
+        cv::Size frame;                // detection frame size it was rasterised for
+        cv::Rect bounds;               // in the detection frame
+        cv::Mat mask;                  // bounds sized, 255 = in the zone
+        int min_pixels;                // foreground pixels that trigger the alarm
+        std::vector<cv::Point> points; // outline to draw, empty for the alarm pixels
+
+        int count(const std::vector<DetectTile>& tiles, cv::Mat& scratch) const; // foreground pixels in the zone
+    };
+    struct AlarmPolygon {
+        int min_pixels;
+        std::vector<cv::Point> points;
+    };
+    cv::Size m_detect_tiles_size;
+    DetectEngineParams m_detect_engine_params;
+    bool m_detect_vectors{false}; // -de mv, the detection readers export motion vectors
+    std::unique_ptr<DetectEngineBench> m_engine_bench; // bench_cpu only
+
+    FramePool m_detection_pool;
+    std::shared_ptr<Frame> m_frame_detection; // written by detection thread until published
+    FrameMailbox m_frame_detection_mailbox;
+    uint64_t m_detection_generation{0};
     cv::UMat m_canv1;
     cv::UMat m_canv2;
     cv::UMat m_main_display;
 
+    // dirty tile compositing, a tile is only rendered again when its source or position changed
+    struct TilePlacement {
+        int channel;
+        cv::Rect rect;
+    };
+    struct Tile {
+        int channel{-1};
+        cv::Rect rect;
+        uint64_t generation{0}; // of the frame on the canvas
+        bool overlay{false};    // motion region drawn over it
+    };
+    std::vector<TilePlacement> m_tile_placements; // filled by the compositor of the current layout
+    std::array<Tile, CHANNEL_COUNT> m_tiles;
+    int m_tiles_layout{-1}; // display mode the tiles were rendered for
+    int m_tiles_rendered_now{0};
+    std::atomic<uint64_t> m_tiles_rendered{0};
+    std::atomic<uint64_t> m_tiles_skipped{0};
+    int m_view{0};                 // single (-1), detection (-2) or display mode last shown
+    uint64_t m_view_generation{0}; // frame last shown in a single view
+
     // motion detecting / min frames
-    DoubleBuffer<cv::Rect> m_motion_region;
+    SeqLock<cv::Rect> m_motion_region;
     std::atomic<bool> m_motion_detected{false};
     std::atomic<bool> m_motion_detected_min_ms{false};
     std::chrono::high_resolution_clock::time_point m_motion_detect_start;
@@ -128,12 +241,41 @@ class MotionDetector {
     std::chrono::high_resolution_clock::time_point m_motion_detect_linger_start;
     bool m_motion_detect_linger_start_set;
 
-    // draw & motion sleeps
+    // draw sleeps
     int64_t m_sleep_ms_draw{-1};
     bool m_sleep_ms_draw_auto{true};
-    int64_t m_sleep_ms_motion{-1};
-    bool m_sleep_ms_motion_auto{true};
-    int64_t m_sleep_ms_ch0{-1};
+
+    // detection is driven by new frames of this reader (0 or focus channel)
+    int m_detect_channel{0};
+    std::atomic<uint64_t> m_detect_processed{0};
+    std::atomic<uint64_t> m_detect_skipped{0};     // published while the detector was busy
+    std::atomic<uint64_t> m_detect_duplicate{0};   // woken up without a new frame
+    std::atomic<uint64_t> m_detect_allocations{0}; // debug_alloc: by tile workers during the current frame
+    std::atomic<int> m_alloc_check{-1};            // debug_alloc: synthetic input, see alloc_check()
+
+    // adaptive detection rate, detection thread state and what it reports
+    std::chrono::steady_clock::time_point m_detect_foreground; // last foreground pixels seen
+    std::chrono::steady_clock::time_point m_detect_last_run;
+    bool m_detect_ran{false};                        // the last frame was detected, not only passed on
+    std::atomic<int64_t> m_detect_workers_cpu_us{0}; // tile workers other than the detection thread, current frame
+    std::chrono::steady_clock::time_point m_detect_window_start;
+    int m_detect_window_runs{0};
+    double m_detect_window_cpu_ms{0};
+    std::atomic<bool> m_detect_idle{false};
+    std::atomic<double> m_detect_rate{0};   // detected frames per second
+    std::atomic<double> m_detect_cpu_ms{0}; // average per detected frame
+    std::atomic<double> m_detect_cpu{0};    // percent of one core
+
+    // latency tracing of what the draw loop shows
+    struct DrawnFrame {
+        int channel;
+        std::chrono::steady_clock::time_point received;
+        std::chrono::steady_clock::time_point published;
+    };
+    std::vector<DrawnFrame> m_drawn_frames;
+    std::array<std::chrono::steady_clock::time_point, CHANNEL_COUNT + 1> m_drawn_published{}; // each frame is recorded once
+    int m_latency_report_s;
+    std::chrono::steady_clock::time_point m_latency_report_start;
 
     // tour
     std::atomic<int> m_tour_current_channel{1};
@@ -147,16 +289,21 @@ class MotionDetector {
     std::mutex m_mtx_draw;
     std::condition_variable m_cv_draw;
 
-    std::mutex m_mtx_ch0;
-    std::condition_variable m_cv_ch0;
-
     std::mutex m_mtx_motion;
     std::condition_variable m_cv_motion;
 
-    // ignore area
-    DoubleBuffer<std::vector<std::vector<cv::Point>>> m_ignore_contours;
-    DoubleBuffer<std::vector<cv::Point>> m_ignore_contour;
+    // ignore area, the contours belong to the draw thread (startup and keys), the detection
+    // thread only reads the mask they are rasterised into whenever they change
+    std::vector<std::vector<cv::Point>> m_ignore_contours;
+    std::vector<cv::Point> m_ignore_contour;
+    TripleBuffer<cv::Mat> m_ignore_mask; // detection frame sized, 255 = ignored, empty if there is nothing to ignore
+
+    // alarm pixels, draw thread only like the ignore contours, detection reads the rasterised zones
+    std::vector<cv::Point> m_alarm_pixels;
 
-    // alarm pixels
-    DoubleBuffer<std::vector<cv::Point>> m_alarm_pixels;
+    // alarm zones, the polygons are fixed at startup, the detection thread only reads the rasterised zones
+    std::vector<AlarmPolygon> m_alarm_polygons;
+    int m_alarm_zone_min;
+    TripleBuffer<std::vector<AlarmZone>> m_alarm_zones;
+    cv::Mat m_alarm_scratch; // detection thread
 };
@@ -1,4 +1,5 @@
 #include "debug.hpp"
+#include "latency.hpp"
 #include "motion_detector.hpp"
 #include "utils.hpp"
 
@@ -14,6 +15,24 @@ void on_mouse(int event, int x, int y, int flags, void* userdata)
     }
 }
 
+void MotionDetector::mark_drawn(const FramePtr& frame)
+{
+    if (!frame) { return; }
+    m_drawn_frames.push_back({frame->channel, frame->received, frame->published});
+}
+
+void MotionDetector::record_drawn()
+{
+    auto shown = std::chrono::steady_clock::now();
+    for (const DrawnFrame& drawn : m_drawn_frames) {
+        if (drawn.channel < 0 || drawn.channel > CHANNEL_COUNT || drawn.published == m_drawn_published[drawn.channel]) { continue; }
+        m_drawn_published[drawn.channel] = drawn.published;
+        LatencyTracker::get().record(drawn.channel, LATENCY_STAGE_DISPLAY, drawn.published, shown);
+        LatencyTracker::get().record(drawn.channel, LATENCY_STAGE_TOTAL, drawn.received, shown);
+    }
+    m_drawn_frames.clear();
+}
+
 void MotionDetector::draw_loop()
 {
     cv::namedWindow(DEFAULT_WINDOW_NAME);
@@ -32,6 +51,7 @@ void MotionDetector::draw_loop()
 #endif
 
         std::chrono::time_point<std::chrono::high_resolution_clock> draw_start;
+        m_latency_report_start = std::chrono::steady_clock::now();
 
         while (m_running) {
 
@@ -43,17 +63,45 @@ void MotionDetector::draw_loop()
             }
 
             if (m_enable_tour) { do_tour_logic(); }
+            update_decode_levels();
 
-            cv::UMat get;
-            if (m_enable_minimap_fullscreen || m_focus_channel != -1) {
-                get = m_frame_detection_dbuff.get();
+            // the focus detection size is only known from the frames, rasterise again when it changed
+            if (m_focus_channel != -1 && rasterise_size() != m_rasterised_size) {
+                update_ignore_mask();
+                update_alarm_zones();
+            }
+            m_drawn_frames.clear();
+
+            // switching between single and tiled views repaints everything once
+            int view = (m_enable_minimap_fullscreen || m_focus_channel != -1) ? -2
+                     : (m_enable_fullscreen_channel || (m_display_mode == DISPLAY_MODE_SINGLE) ||
+                        (m_enable_motion && m_enable_motion_zoom_largest && (m_motion_detected_min_ms || m_motion_detect_linger)))
+                         ? -1
+                         : static_cast<int>(m_display_mode);
+            if (view != m_view) {
+                m_view = view;
+                m_layout_changed = true;
             }
-            else if (m_enable_fullscreen_channel ||
-                     (m_display_mode == DISPLAY_MODE_SINGLE) ||
-                     (m_enable_motion && m_enable_motion_zoom_largest && (m_motion_detected_min_ms || m_motion_detect_linger))) {
 
-                get = get_frame(m_current_channel, m_layout_changed);
-                draw_paint_info_motion_region(get, 0, 0, get.size().width, get.size().height);
+            cv::UMat get;
+            cv::Mat single; // pooled frame, read only, motion region is drawn after resize
+            FramePtr single_hold;
+            bool single_region = false;
+            if (view == -2) {
+                bool layout_changed = m_layout_changed.exchange(false);
+                single_hold = m_frame_detection_mailbox.peek();
+                if (single_hold && (layout_changed || single_hold->generation != m_view_generation)) {
+                    m_view_generation = single_hold->generation;
+                    single = single_hold->mat;
+                    mark_drawn(single_hold);
+                }
+            }
+            else if (view == -1) {
+                bool layout_changed = m_layout_changed.exchange(false);
+                single = get_frame(m_current_channel, layout_changed, single_hold);
+                if (!single.empty() && !layout_changed && single_hold->generation == m_view_generation) { single = cv::Mat(); } // low cpu peeks channel 0
+                if (!single.empty()) { m_view_generation = single_hold->generation; }
+                single_region = true;
             }
             else if (m_display_mode == DISPLAY_MODE_SORT) {
                 get = draw_paint_main_mat_sort();
@@ -67,21 +115,40 @@ void MotionDetector::draw_loop()
             else if (m_display_mode == DISPLAY_MODE_ALL) {
                 get = draw_paint_main_mat_all();
             }
+            bool changed = !single.empty() || (!get.empty() && m_tiles_rendered_now > 0);
 
-            if (!get.empty()) {
-                if (!NO_RESIZE && get.size() != cv::Size(m_display_width, m_display_height)) {
-                    cv::resize(get, m_main_display, cv::Size(m_display_width, m_display_height));
+            // nothing new on screen, skip the resize and imshow
+            if (changed) {
+                const cv::_InputArray src = single.empty() ? cv::_InputArray(get) : cv::_InputArray(single);
+                if (!NO_RESIZE && src.size() != cv::Size(m_display_width, m_display_height)) {
+                    cv::resize(src, m_main_display, cv::Size(m_display_width, m_display_height));
                 }
                 else {
-                    get.copyTo(m_main_display);
+                    src.copyTo(m_main_display);
                 }
 
+                if (single_region) {
+                    draw_paint_info_motion_region(m_main_display, 0, 0, m_main_display.size().width, m_main_display.size().height);
+                }
+                if (view == -2 && !single.empty()) { draw_paint_detection_rects(*single_hold); }
+                if (m_enable_info) { draw_paint_info_text(); }
+
                 cv::imshow(DEFAULT_WINDOW_NAME, m_main_display);
+                record_drawn();
 
                 if (m_display_width == 0) { m_display_width = m_main_display.size().width; }
                 if (m_display_height == 0) { m_display_height = m_main_display.size().height; }
+            }
+
+            // the window still has to process events when nothing was shown
+            if (!m_main_display.empty()) { draw_loop_handle_keys(); }
+
+            // debug_alloc: the synthetic input's allocation check is done, quit like 'q'
+            D_ALLOC(if (m_running && m_alloc_check >= 0) { stop(); });
 
-                draw_loop_handle_keys();
+            if (m_latency_report_s > 0 && std::chrono::steady_clock::now() - m_latency_report_start >= std::chrono::seconds(m_latency_report_s)) {
+                LatencyTracker::get().print();
+                m_latency_report_start = std::chrono::steady_clock::now();
             }
 
             if (m_sleep_ms_draw_auto) {
@@ -133,7 +200,7 @@ void MotionDetector::draw_loop_handle_keys()
     else if (key == KEY_LINUX_ARROW_UP || key == KEY_WIN_ARROW_UP) { m_display_mode++; if (m_display_mode > 4) { m_display_mode = 4; } }
     else if (key == KEY_LINUX_ARROW_DOWN || key == KEY_WIN_ARROW_DOWN) { m_display_mode--; if (m_display_mode < 0) { m_display_mode = 0; } }
     else if (key == 'i' || key == KEY_LINUX_PAGE_UP || key == KEY_WIN_PAGE_UP) { m_enable_info = !m_enable_info; }
-    else if (key == 'o' || key == KEY_LINUX_PAGE_DOWN || key == KEY_LINUX_PAGE_DOWN) { m_enable_minimap = !m_enable_minimap; }
+    else if (key == 'o' || key == KEY_LINUX_PAGE_DOWN || key == KEY_LINUX_PAGE_DOWN) { m_enable_minimap = !m_enable_minimap; update_reader_outputs(); }
     else if (key == 'f' || key == '+') { m_enable_fullscreen_channel = !m_enable_fullscreen_channel; }
     else if (key == 't' || key == '.') { m_enable_tour = !m_enable_tour; }
     else if (key == 'r' || key == KEY_BACKSPACE) {
@@ -145,9 +212,11 @@ void MotionDetector::draw_loop_handle_keys()
         m_enable_minimap = ENABLE_MINIMAP;
         m_enable_fullscreen_channel = ENABLE_FULLSCREEN_CHANNEL;
         m_enable_tour = ENABLE_TOUR;
+        update_reader_outputs();
     }
     else if (key == '0') {
         m_enable_minimap_fullscreen = !m_enable_minimap_fullscreen;
+        update_reader_outputs();
     }
     else if (key == KEY_LINUX_ARROW_LEFT || key == KEY_WIN_ARROW_LEFT) {
         int new_ch = m_current_channel + 1;
@@ -162,44 +231,42 @@ void MotionDetector::draw_loop_handle_keys()
         change_channel(key - '0');
     }
     else if (key == 'c') {
-        auto ic = m_ignore_contour.get();
         auto mp = m_mouse_pos.get();
         if (mp != cv::Point()) {
-            ic.push_back(mp);
-            m_ignore_contour.update(ic);
+            m_ignore_contour.push_back(mp);
+            update_ignore_mask();
         }
     }
     else if (key == 'v') {
-        auto ic = m_ignore_contour.get();
         std::cout << "contour: ";
-        print_contour(ic);
+        print_contour(m_ignore_contour);
         std::cout << std::endl;
-        if (!ic.empty()) {
-            auto ics = m_ignore_contours.get();
-            ics.push_back(ic);
-            m_ignore_contours.update(ics);
-            m_ignore_contour.update({});
+        if (!m_ignore_contour.empty()) {
+            m_ignore_contours.push_back(m_ignore_contour);
+            m_ignore_contour.clear();
+            update_ignore_mask();
             print_ignore_contours();
         }
     }
     else if (key == 'b') {
         std::cout << "cleared all ignore area/contours" << std::endl;
-        m_ignore_contours.update({});
-        m_ignore_contour.update({});
+        m_ignore_contours.clear();
+        m_ignore_contour.clear();
+        update_ignore_mask();
     }
     else if (key == 'd' || key == KEY_ENTER) {
         m_enable_alarm_pixels = !m_enable_alarm_pixels;
     }
     else if (key == 'z') {
         std::cout << "cleared all alarm pixels" << std::endl;
-        m_alarm_pixels.update({});
+        m_alarm_pixels.clear();
+        update_alarm_zones();
     }
     else if (key == 'x') {
-        auto aps = m_alarm_pixels.get();
         auto mp = m_mouse_pos.get();
         if (mp != cv::Point()) {
-            aps.push_back(mp);
-            m_alarm_pixels.update(aps);
+            m_alarm_pixels.push_back(mp);
+            update_alarm_zones();
         }
         print_alarm_pixels();
     }
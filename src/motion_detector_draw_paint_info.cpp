@@ -1,3 +1,4 @@
+#include "latency.hpp"
 #include "motion_detector.hpp"
 #include "utils.hpp"
 
@@ -37,18 +38,41 @@ void MotionDetector::draw_paint_info_text()
     cv::putText(m_main_display, "Alarm (d/ENTER): " + bool_to_str(m_enable_alarm_pixels),
                 cv::Point(10, text_y_start + i++ * text_y_step), cv::FONT_HERSHEY_SIMPLEX,
                 font_scale, text_color, font_thickness);
+    cv::putText(m_main_display, "Detect Frames: " + std::to_string(m_detect_processed) + " ; skipped " + std::to_string(m_detect_skipped) + " ; duplicate " + std::to_string(m_detect_duplicate),
+                cv::Point(10, text_y_start + i++ * text_y_step), cv::FONT_HERSHEY_SIMPLEX,
+                font_scale, text_color, font_thickness);
+    cv::putText(m_main_display, "Detect Rate: " + cv::format("%.1f", m_detect_rate.load()) + " fps" + (m_detect_idle ? " (idle)" : "") + " ; cpu " + cv::format("%.1f", m_detect_cpu_ms.load()) + " ms/frame, " + cv::format("%.1f", m_detect_cpu.load()) + "%",
+                cv::Point(10, text_y_start + i++ * text_y_step), cv::FONT_HERSHEY_SIMPLEX,
+                font_scale, text_color, font_thickness);
+    LatencyPercentiles total = LatencyTracker::get().percentiles(m_current_channel, LATENCY_STAGE_TOTAL);
+    LatencyPercentiles detect = LatencyTracker::get().percentiles(m_detect_channel, LATENCY_STAGE_DETECT);
+    cv::putText(m_main_display, "Latency p50/p95: shown " + cv::format("%.0f/%.0f", total.p50, total.p95) + " ms ; detect " + cv::format("%.0f/%.0f", detect.p50, detect.p95) + " ms",
+                cv::Point(10, text_y_start + i++ * text_y_step), cv::FONT_HERSHEY_SIMPLEX,
+                font_scale, text_color, font_thickness);
+    cv::putText(m_main_display, "Tiles: rendered " + std::to_string(m_tiles_rendered) + " ; skipped " + std::to_string(m_tiles_skipped),
+                cv::Point(10, text_y_start + i++ * text_y_step), cv::FONT_HERSHEY_SIMPLEX,
+                font_scale, text_color, font_thickness);
     cv::putText(m_main_display, "Reset (r/BACKSPACE)",
                 cv::Point(10, text_y_start + i++ * text_y_step), cv::FONT_HERSHEY_SIMPLEX,
                 font_scale, text_color, font_thickness);
+
+    // per channel decode cost, to tune --decode_threads / --decode_workers
+    for (size_t ch = 0; ch < m_readers.size(); ch++) {
+        if (!m_readers[ch]->is_active()) { continue; }
+        DecodeStats stats = m_readers[ch]->get_decode_stats();
+        cv::putText(m_main_display, "Decode " + std::to_string(ch) + ": " + cv::format("%.1f", stats.decode_ms) + " ms ; queue " + std::to_string(stats.queue_depth) + " ; threads " + std::to_string(stats.threads) + " ; dropped " + std::to_string(stats.dropped) + " ; frames " + std::to_string(stats.produced) + "/" + std::to_string(stats.consumed) + " (overwritten " + std::to_string(stats.overwritten) + ")",
+                    cv::Point(10, text_y_start + i++ * text_y_step), cv::FONT_HERSHEY_SIMPLEX,
+                    font_scale, text_color, font_thickness);
+    }
 }
 
 void MotionDetector::draw_paint_info_minimap()
 {
-    cv::UMat frame0 = m_frame_detection_dbuff.get();
-    if (frame0.empty()) { return; }
+    FramePtr frame0 = m_frame_detection_mailbox.peek();
+    if (!frame0 || frame0->mat.empty()) { return; }
 
     cv::UMat minimap;
-    cv::resize(frame0, minimap, cv::Size(MINIMAP_WIDTH, MINIMAP_HEIGHT));
+    cv::resize(frame0->mat, minimap, cv::Size(MINIMAP_WIDTH, MINIMAP_HEIGHT));
 
     // Add white border
     cv::UMat minimap_padded;
@@ -113,3 +137,20 @@ void MotionDetector::draw_paint_info_motion_region(cv::UMat& canv, size_t posX,
 
     cv::rectangle(canv, new_motion_region, cv::Scalar(0, 0, 255), m_motion_region_info_rect_width);
 }
+
+// focus frames are detected at their own resolution, their rectangles are only mapped to the window here
+void MotionDetector::draw_paint_detection_rects(const Frame& frame)
+{
+    if (frame.mat.empty() || (frame.rects.empty() && frame.region.empty())) { return; }
+
+    double sx = static_cast<double>(m_main_display.cols) / frame.mat.cols;
+    double sy = static_cast<double>(m_main_display.rows) / frame.mat.rows;
+    auto scaled = [&](const cv::Rect& r) {
+        return cv::Rect(cvRound(r.x * sx), cvRound(r.y * sy), cvRound(r.width * sx), cvRound(r.height * sy));
+    };
+
+    for (const cv::Rect& rect : frame.rects) {
+        cv::rectangle(m_main_display, scaled(rect), cv::Scalar(0, 255, 0), 1);
+    }
+    if (!frame.region.empty()) { cv::rectangle(m_main_display, scaled(frame.region), cv::Scalar(0, 0, 255), 2); }
+}
@@ -1,142 +1,141 @@
 #include "motion_detector.hpp"
 
-cv::UMat MotionDetector::draw_paint_main_mat_all()
+// king / top layouts: one 3x3 tile and 7 small ones around it on a 4x4 grid
+static cv::Rect king_rect(int position, int w, int h)
+{
+    switch (position) {
+        case 0:  return cv::Rect(0, 0, w * 3, h * 3);
+        case 1:  return cv::Rect(3 * w, 0 * h, w, h);
+        case 2:  return cv::Rect(3 * w, 1 * h, w, h);
+        case 3:  return cv::Rect(3 * w, 2 * h, w, h);
+        case 4:  return cv::Rect(0 * w, 3 * h, w, h);
+        case 5:  return cv::Rect(1 * w, 3 * h, w, h);
+        case 6:  return cv::Rect(2 * w, 3 * h, w, h);
+        default: return cv::Rect(3 * w, 3 * h, w, h);
+    }
+}
+
+// Renders only the tiles whose source frame, channel or position changed since
+// the last call, everything else keeps what is already on the canvas.
+// Frames are fetched here (draw thread), only the resizing runs in parallel.
+void MotionDetector::draw_paint_tiles(cv::UMat& canvas, int layout)
 {
-    bool layout_changed = m_layout_changed;
-    size_t w = m_display_width / 3;
-    size_t h = m_display_height / 3;
+    bool layout_changed = m_layout_changed.exchange(false) || layout != m_tiles_layout;
+    m_tiles_layout = layout;
+    if (layout_changed) { m_tiles.fill(Tile{}); }
+    bool region = m_enable_info_rect && m_motion_detected_min_ms;
+
+    std::array<FramePtr, CHANNEL_COUNT> holds;
+    std::array<cv::Mat, CHANNEL_COUNT> mats;
+    std::array<bool, CHANNEL_COUNT> overlays{};
+    int count = std::min(static_cast<int>(m_tile_placements.size()), CHANNEL_COUNT);
+    int rendered = 0;
+
+    for (int i = 0; i < count; i++) {
+        const TilePlacement& placement = m_tile_placements[i];
+        Tile& tile = m_tiles[i];
+
+        // the motion rectangle is drawn over the tile, so it is repainted while it shows one
+        overlays[i] = region && placement.channel == m_current_channel;
+        bool repaint = tile.channel != placement.channel || tile.rect != placement.rect || overlays[i] || tile.overlay;
+
+        mats[i] = get_frame(placement.channel, repaint, holds[i]);
+        if (mats[i].empty() || (!repaint && holds[i]->generation == tile.generation)) {
+            mats[i] = cv::Mat();
+            continue;
+        }
+
+        tile.channel = placement.channel;
+        tile.rect = placement.rect;
+        tile.generation = holds[i]->generation;
+        tile.overlay = overlays[i];
+        rendered++;
+    }
 
-    cv::parallel_for_(cv::Range(0, CHANNEL_COUNT), [&](const cv::Range& range) {
+    cv::parallel_for_(cv::Range(0, count), [&](const cv::Range& range) {
         for (int i = range.start; i < range.end; i++) {
-            int ch = i + 1;
-            cv::UMat mat = get_frame(ch, layout_changed);
-            if (mat.empty()) { continue; }
-
-            int row = i / 3;
-            int col = i % 3;
-            int x = col * w;
-            int y = row * h;
-            cv::resize(mat, m_canv2(cv::Rect(x, y, w, h)), cv::Size(w, h));
-            if (ch == m_current_channel) {
-                draw_paint_info_motion_region(m_canv2, x, y, w, h);
+            if (mats[i].empty()) { continue; }
+            const cv::Rect& rect = m_tile_placements[i].rect;
+            cv::resize(mats[i], canvas(rect), rect.size());
+            if (overlays[i]) {
+                draw_paint_info_motion_region(canvas, rect.x, rect.y, rect.width, rect.height);
             }
         }
     });
 
-    m_layout_changed = false;
+    m_tiles_rendered_now = rendered;
+    m_tiles_rendered += rendered;
+    m_tiles_skipped += count - rendered;
+}
+
+cv::UMat MotionDetector::draw_paint_main_mat_all()
+{
+    int w = m_display_width / 3;
+    int h = m_display_height / 3;
+
+    m_tile_placements.clear();
+    for (int i = 0; i < CHANNEL_COUNT; i++) {
+        int row = i / 3;
+        int col = i % 3;
+        m_tile_placements.push_back({i + 1, cv::Rect(col * w, row * h, w, h)});
+    }
+
+    draw_paint_tiles(m_canv2, DISPLAY_MODE_ALL);
     return m_canv2;
 }
 
 cv::UMat MotionDetector::draw_paint_main_mat_sort()
 {
-    bool layout_changed = m_layout_changed;
-    size_t w = m_display_width / 3;
-    size_t h = m_display_height / 3;
+    int w = m_display_width / 3;
+    int h = m_display_height / 3;
 
     std::vector vec = m_king_chain.get();
 
-    cv::parallel_for_(cv::Range(0, CHANNEL_COUNT), [&](const cv::Range& range) {
-        for (int i = range.start; i < range.end; i++) {
-            int ch = vec[i];
-            cv::UMat mat = get_frame(ch, layout_changed);
-            if (mat.empty()) { continue; }
-
-            int row = i / 3;
-            int col = i % 3;
-            int x = col * w;
-            int y = row * h;
-            cv::resize(mat, m_canv2(cv::Rect(x, y, w, h)), cv::Size(w, h));
-            if (ch == m_current_channel) {
-                draw_paint_info_motion_region(m_canv2, x, y, w, h);
-            }
-        }
-    });
+    m_tile_placements.clear();
+    for (int i = 0; i < CHANNEL_COUNT; i++) {
+        int row = i / 3;
+        int col = i % 3;
+        m_tile_placements.push_back({vec[i], cv::Rect(col * w, row * h, w, h)});
+    }
 
-    m_layout_changed = false;
+    draw_paint_tiles(m_canv2, DISPLAY_MODE_SORT);
     return m_canv2;
 }
 
 cv::UMat MotionDetector::draw_paint_main_mat_king()
 {
-    bool layout_changed = m_layout_changed;
-    size_t w = m_display_width / 4;
-    size_t h = m_display_height / 4;
+    int w = m_display_width / 4;
+    int h = m_display_height / 4;
 
     std::vector vec = m_king_chain.get();
 
-    cv::parallel_for_(cv::Range(0, CHANNEL_COUNT), [&](const cv::Range& range) {
-        for (int i = range.start; i < range.end; i++) {
-            cv::UMat mat = get_frame(vec[i], layout_changed);
-            if (mat.empty()) { continue; }
-
-            switch (i) {
-                case 0:
-                    {
-                        size_t w0 = w * 3;
-                        size_t h0 = h * 3;
-                        cv::resize(mat, m_canv1(cv::Rect(0, 0, w0, h0)), cv::Size(w0, h0));
-                        draw_paint_info_motion_region(m_canv1, 0, 0, w0, h0);
-                        break;
-                    }
-                case 1: cv::resize(mat, m_canv1(cv::Rect(3 * w, 0 * h, w, h)), cv::Size(w, h)); break;
-                case 2: cv::resize(mat, m_canv1(cv::Rect(3 * w, 1 * h, w, h)), cv::Size(w, h)); break;
-                case 3: cv::resize(mat, m_canv1(cv::Rect(3 * w, 2 * h, w, h)), cv::Size(w, h)); break;
-                case 4: cv::resize(mat, m_canv1(cv::Rect(0 * w, 3 * h, w, h)), cv::Size(w, h)); break;
-                case 5: cv::resize(mat, m_canv1(cv::Rect(1 * w, 3 * h, w, h)), cv::Size(w, h)); break;
-                case 6: cv::resize(mat, m_canv1(cv::Rect(2 * w, 3 * h, w, h)), cv::Size(w, h)); break;
-                case 7: cv::resize(mat, m_canv1(cv::Rect(3 * w, 3 * h, w, h)), cv::Size(w, h)); break;
-            }
-        }
-    });
+    m_tile_placements.clear();
+    for (int i = 0; i < CHANNEL_COUNT; i++) {
+        m_tile_placements.push_back({vec[i], king_rect(i, w, h)});
+    }
 
-    m_layout_changed = false;
+    draw_paint_tiles(m_canv1, DISPLAY_MODE_KING);
     return m_canv1;
 }
 
 cv::UMat MotionDetector::draw_paint_main_mat_top()
 {
-    bool layout_changed = m_layout_changed;
-    size_t w = m_display_width / 4;
-    size_t h = m_display_height / 4;
-
-    std::vector<int> active_channels;
-    for (int i = 1; i <= CHANNEL_COUNT; i++) {
-        if (i != m_current_channel) {
-            active_channels.push_back(i);
+    int w = m_display_width / 4;
+    int h = m_display_height / 4;
+
+    // current channel large, the rest clockwise around it
+    static constexpr int positions[CHANNEL_COUNT] = {0, 1, 2, 3, 7, 6, 5, 4};
+
+    m_tile_placements.clear();
+    m_tile_placements.push_back({m_current_channel, king_rect(0, w, h)});
+    int i = 1;
+    for (int ch = 1; ch <= CHANNEL_COUNT; ch++) {
+        if (ch != m_current_channel && i < CHANNEL_COUNT) {
+            m_tile_placements.push_back({ch, king_rect(positions[i], w, h)});
+            i++;
         }
     }
 
-    cv::parallel_for_(cv::Range(0, CHANNEL_COUNT), [&](const cv::Range& range) {
-        for (int i = range.start; i < range.end; i++) {
-            cv::UMat mat;
-
-            if (i == 0) {
-                mat = get_frame(m_current_channel, layout_changed);
-                if (mat.empty()) { continue; }
-
-                size_t w0 = w * 3;
-                size_t h0 = h * 3;
-                cv::resize(mat, m_canv1(cv::Rect(0, 0, w0, h0)), cv::Size(w0, h0));
-                draw_paint_info_motion_region(m_canv1, 0, 0, w0, h0);
-            }
-            else {
-                int channel = active_channels[i - 1];
-                mat = get_frame(channel, layout_changed);
-                if (mat.empty()) { continue; }
-
-                switch (i) {
-                    case 1: cv::resize(mat, m_canv1(cv::Rect(3 * w, 0 * h, w, h)), cv::Size(w, h)); break;
-                    case 2: cv::resize(mat, m_canv1(cv::Rect(3 * w, 1 * h, w, h)), cv::Size(w, h)); break;
-                    case 3: cv::resize(mat, m_canv1(cv::Rect(3 * w, 2 * h, w, h)), cv::Size(w, h)); break;
-                    case 7: cv::resize(mat, m_canv1(cv::Rect(0 * w, 3 * h, w, h)), cv::Size(w, h)); break;
-                    case 6: cv::resize(mat, m_canv1(cv::Rect(1 * w, 3 * h, w, h)), cv::Size(w, h)); break;
-                    case 5: cv::resize(mat, m_canv1(cv::Rect(2 * w, 3 * h, w, h)), cv::Size(w, h)); break;
-                    case 4: cv::resize(mat, m_canv1(cv::Rect(3 * w, 3 * h, w, h)), cv::Size(w, h)); break;
-                }
-            }
-        }
-    });
-
-    m_layout_changed = false;
+    draw_paint_tiles(m_canv1, DISPLAY_MODE_TOP);
     return m_canv1;
 }
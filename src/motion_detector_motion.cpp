@@ -1,36 +1,29 @@
 #include "debug.hpp"
 #include "globals.hpp"
+#include "latency.hpp"
 #include "motion_detector.hpp"
 #include "utils.hpp"
 #include <SDL2/SDL_mixer.h>
+#include <algorithm>
+#include <cmath>
 
 extern Mix_Chunk* g_sfx_8bit_clicky;
 
-void MotionDetector::update_ch0()
+// called from the detection reader's thread after it published a frame
+void MotionDetector::notify_detection()
 {
+    { std::lock_guard<std::mutex> lock(m_mtx_motion); } // no lost wakeup between predicate check and wait
+    m_cv_motion.notify_one();
+}
 
-    while (m_running) {
-        auto update_ch0_start = std::chrono::high_resolution_clock::now();
-
-        cv::UMat frame0_get = m_readers[0]->get_latest_frame(false);
-        if (!frame0_get.empty() && frame0_get.size().width == W_0 && frame0_get.size().height == H_0) {
-            m_frame0 = frame0_get;
-            m_frame0_dbuff.update(m_frame0);
-        }
-
-        // Calculate sleep time based on measured FPS
-        double fps = m_readers[0]->get_fps();
-        double frame_time = (fps > 0.0) ? (1.0 / fps) : 1.0 / 20.0; // Default to 20 FPS if zero
-        auto detect_time = std::chrono::high_resolution_clock::now() - update_ch0_start;
-
-        auto sleep_time = std::chrono::duration<double>(frame_time) - detect_time;
-        m_sleep_ms_ch0 = std::chrono::duration_cast<std::chrono::milliseconds>(sleep_time).count();
-
-        {
-            std::unique_lock<std::mutex> lock(m_mtx_ch0);
-            m_cv_ch0.wait_for(lock, std::chrono::milliseconds(m_sleep_ms_ch0), [&] { return !m_running; });
-        }
-    }
+// the macroblocks under roi (Frame::motion) scaled onto dst, a block moves as a whole
+static void expand_motion_vectors(const cv::Mat& grid, const cv::Rect& roi, cv::Mat dst)
+{
+    cv::Point tl(roi.x / MOTION_VECTOR_BLOCK, roi.y / MOTION_VECTOR_BLOCK);
+    cv::Point br((roi.br().x + MOTION_VECTOR_BLOCK - 1) / MOTION_VECTOR_BLOCK, (roi.br().y + MOTION_VECTOR_BLOCK - 1) / MOTION_VECTOR_BLOCK);
+    cv::Rect cells = cv::Rect(tl, br) & cv::Rect(0, 0, grid.cols, grid.rows);
+    if (cells.empty()) { dst.setTo(0); }
+    else { cv::resize(grid(cells), dst, dst.size(), 0, 0, cv::INTER_NEAREST); }
 }
 
 void MotionDetector::detect_motion()
@@ -38,84 +31,137 @@ void MotionDetector::detect_motion()
 #ifdef DEBUG_FPS
     int i = 0;
 #endif
+#ifdef DEBUG_ALLOC
+    uint64_t alloc_frames = 0;    // detected frames after warm-up
+    uint64_t alloc_total = 0;     // allocations in them
+    uint64_t alloc_allocated = 0; // frames that allocated at all
+    uint64_t alloc_quiet = 0;     // of them without any foreground
+    uint64_t alloc_quiet_allocated = 0;
+#endif
 
     D(std::cout << "starting motion detection" << std::endl);
 
-    std::chrono::time_point<std::chrono::high_resolution_clock> motion_start;
+    bool focus = !m_focus_targets.empty();
+    m_detect_foreground = m_detect_window_start = std::chrono::steady_clock::now(); // full rate at startup
+    FrameReader& source = *m_readers[m_detect_channel];
+    uint64_t last_generation = 0;
 
     while (m_running) {
 
+        {
+            std::unique_lock<std::mutex> lock(m_mtx_motion);
+            m_cv_motion.wait(lock, [&] { return !m_running || (focus ? focus_frames_pending() : source.get_generation() != last_generation); });
+        }
+        if (!m_running) { break; }
+
+        FramePtr frame_get;
+        if (focus) {
+            if (!take_focus_frames()) { continue; }
+        }
+        else {
+            frame_get = source.get_latest_frame(true);
+            if (!frame_get) { continue; }
+            if (frame_get->generation == last_generation) {
+                m_detect_duplicate++;
+                continue;
+            }
+            if (last_generation != 0 && frame_get->generation > last_generation + 1) {
+                m_detect_skipped += frame_get->generation - last_generation - 1;
+            }
+            last_generation = frame_get->generation;
+        }
+
 #ifdef DEBUG_FPS
         i++;
 #endif
 
-        if (m_sleep_ms_motion_auto) {
-            motion_start = std::chrono::high_resolution_clock::now();
-        }
-
         m_motion_detected = false;
-        if (m_enable_motion) {
-
-            if (m_focus_channel == -1) {
-                cv::UMat frame0_get = m_frame0_dbuff.get();
-                if (!frame0_get.empty() && frame0_get.size().width == W_0 && frame0_get.size().height == H_0) {
-                    frame0_get.copyTo(m_frame_detection);
-                    detect_largest_motion_area_set_channel();
+        if (!m_enable_motion) { continue; }
+
+        bool prepared = false;
+        if (!focus) {
+            const cv::Mat& frame0_get = frame_get->mat;
+            const cv::Mat& frame0_luma = frame_get->luma;
+            if (!frame0_luma.empty() && frame0_luma.cols == W_0 && frame0_luma.rows == H_0) {
+                // luma only detection, BGR is only needed if the mosaic is displayed
+                m_frame_detection = m_detection_pool.acquire();
+                m_detection_pool.create(m_frame_detection->luma, W_0, H_0, CV_8UC1);
+                frame0_luma.copyTo(m_frame_detection->luma);
+
+                if (m_enable_minimap || m_enable_minimap_fullscreen) {
+                    m_detection_pool.create(m_frame_detection->mat, W_0, H_0, CV_8UC3);
+                    if (!frame0_get.empty()) { frame0_get.copyTo(m_frame_detection->mat); }
+                    else { cv::cvtColor(frame0_luma, m_frame_detection->mat, cv::COLOR_GRAY2BGR); } // reader not converting yet
                 }
-            }
-            else {
-                cv::UMat frame0_get = m_readers[m_focus_channel]->get_latest_frame(false);
-
-                if (!frame0_get.empty()) {
-                    if (m_focus_channel_area_set.load()) { // Check if the area is set
-                        // Ensure the coordinates are within the bounds of the frame
-                        long x = std::max(0L, m_focus_channel_area_x.load());
-                        long y = std::max(0L, m_focus_channel_area_y.load());
-                        long w = m_focus_channel_area_w.load();
-                        long h = m_focus_channel_area_h.load();
-
-                        if (x + w > frame0_get.cols) w = frame0_get.cols - x;
-                        if (y + h > frame0_get.rows) h = frame0_get.rows - y;
-
-                        if (w > 0 && h > 0) {
-                            // Crop the subregion
-                            cv::UMat roi = frame0_get(cv::Rect(x, y, w, h));
-                            cv::resize(roi, m_frame_detection, cv::Size(m_display_width, m_display_height));
-                            detect_largest_motion_area_set_channel();
-                        }
-                    }
-                    else {
-                        cv::resize(frame0_get, m_frame_detection, cv::Size(m_display_width, m_display_height));
-                        detect_largest_motion_area_set_channel();
-                    }
+                else {
+                    m_frame_detection->mat.release();
                 }
+                prepared = true;
+            }
+            else if (frame0_get.cols == W_0 && frame0_get.rows == H_0) {
+                m_frame_detection = m_detection_pool.acquire(W_0, H_0, CV_8UC3);
+                m_frame_detection->luma.release();
+                frame0_get.copyTo(m_frame_detection->mat);
+                prepared = true;
             }
-        }
-
-        if (m_sleep_ms_motion_auto) {
-
-            int fc = m_focus_channel.load();
-            int frame_to_check = (fc == -1) ? 0 : fc;
 
-            // Calculate sleep time based on measured FPS
-            double fps = m_readers[frame_to_check]->get_fps();
-            double frame_time = (fps > 0.0) ? (1.0 / fps) : 1.0 / 20.0; // Default to 20 FPS if zero
-            auto detect_time = std::chrono::high_resolution_clock::now() - motion_start;
+            if (prepared && m_detect_vectors && !frame_get->motion.empty()) {
+                m_detection_pool.create(m_frame_detection->motion, W_0, H_0, CV_8UC1);
+                expand_motion_vectors(frame_get->motion, cv::Rect(0, 0, W_0, H_0), m_frame_detection->motion);
+            }
+            else if (prepared) {
+                m_frame_detection->motion.release(); // other engines, or a keyframe (the tiles keep their last result)
+            }
+        }
+        else {
+            prepared = prepare_focus_frame();
+        }
 
-            auto sleep_time = std::chrono::duration<double>(frame_time) - detect_time;
-            m_sleep_ms_motion = std::chrono::duration_cast<std::chrono::milliseconds>(sleep_time).count();
+        if (prepared) {
+            D_ALLOC(uint64_t allocs_before = alloc_count());
+            D_ALLOC(m_detect_allocations = 0);
+            double cpu_start = thread_cpu_ms();
+            m_detect_workers_cpu_us = 0;
+            if (frame_get) { m_frame_detection->copy_meta(*frame_get); }
+            detect_largest_motion_area_set_channel();
+            m_detect_processed++;
+            update_detect_rate(thread_cpu_ms() - cpu_start + m_detect_workers_cpu_us / 1000.0);
+
+#ifdef DEBUG_ALLOC
+            uint64_t allocs = alloc_count() - allocs_before + m_detect_allocations;
+            if (m_detect_processed > DETECT_ALLOC_WARMUP) {
+                alloc_frames++;
+                alloc_total += allocs;
+                alloc_allocated += allocs != 0;
+                if (alloc_frames % 300 == 0) {
+                    std::cout << "Motion thread allocations: " << alloc_total << " in " << alloc_frames << " frames, "
+                              << alloc_allocated << " frames allocated" << std::endl;
+                }
 
-#ifdef DEBUG_FPS
-            if (i % 300 == 0) {
-                std::cout << "Motion thread sleep time: " << m_sleep_ms_motion << " ms (fps: " << fps << " )" << std::endl;
+                // frames with motion still allocate (findContours, connectedComponents, parallel_for_),
+                // the synthetic input fails the check when one without any foreground does
+                bool quiet = std::none_of(m_detect_tiles.begin(), m_detect_tiles.end(), [](const DetectTile& tile) { return tile.changed > 0; });
+                if (quiet && m_input.type == INPUT_TYPE_SYNTHETIC && m_alloc_check < 0) {
+                    alloc_quiet++;
+                    alloc_quiet_allocated += allocs != 0;
+                    if (allocs != 0) { std::cerr << "Motion thread: " << allocs << " allocations in a frame without motion" << std::endl; }
+                    if (alloc_quiet == DETECT_ALLOC_CHECK) {
+                        std::cout << "Motion thread allocation check: " << alloc_quiet_allocated << " of " << alloc_quiet
+                                  << " frames without motion allocated" << std::endl;
+                        m_alloc_check = alloc_quiet_allocated != 0;
+                    }
+                }
             }
 #endif
         }
 
-        {
-            std::unique_lock<std::mutex> lock(m_mtx_motion);
-            m_cv_motion.wait_for(lock, std::chrono::milliseconds(m_sleep_ms_motion), [&] { return !m_running; });
+#ifdef DEBUG_FPS
+        if (i % 300 == 0) {
+            std::cout << "Motion thread frames: " << m_detect_processed << " processed, "
+                      << m_detect_skipped << " skipped, "
+                      << m_detect_duplicate << " duplicate" << std::endl;
         }
+#endif
     }
 
     D(std::cout << "ending motion detection" << std::endl);
@@ -126,74 +172,110 @@ void MotionDetector::detect_largest_motion_area_set_channel()
     // NOTE: Motion detection uses cv::Mat internally because:
     // 1. BackgroundSubtractor works with Mat
     // 2. findContours works with Mat
-    // 3. pointPolygonTest works with Mat
-    // Convert UMat to Mat for processing, then back
-
-    cv::Mat frame_cpu = m_frame_detection.getMat(cv::ACCESS_RW);
-
-    // ignore area by blacking it out
+    // 3. alarm zones are counted on the Mat foreground masks
+    // The detection frame is a pooled Mat, it becomes read only once published
+    // Detection runs on the luma plane if there is one, drawing goes to the BGR mat (only there if displayed)
+
+    cv::Mat frame_pixels = m_frame_detection->luma.empty() ? m_frame_detection->mat : m_frame_detection->luma;
+    cv::Mat frame_cpu = m_frame_detection->motion.empty() ? frame_pixels : m_frame_detection->motion; // -de mv
+    cv::Mat frame_draw = m_frame_detection->mat;
+    bool draw_info = !frame_draw.empty() && (m_enable_minimap || m_enable_minimap_fullscreen) && m_enable_info_rect;
+    bool draw_scaled = m_focus_channel != -1; // rectangles are drawn by the draw loop after scaling to the window
+    m_frame_detection->rects.clear();         // pooled, keeps its capacity
+    m_frame_detection->region = cv::Rect();
+
+    // ignore area, masked out of the foreground of every tile
+    cv::Mat ignore;
     if (m_enable_ignore_contours) {
-        auto ics = m_ignore_contours.get();
-        auto ic = m_ignore_contour.get();
-        std::vector<std::vector<cv::Point>> outline = {ic};
-        cv::polylines(frame_cpu, outline, false, cv::Scalar(0));
-
-        if (!ics.empty()) {
-            // erase empty
-            for (size_t i = 0; i < ics.size(); ++i) {
-                if (ics[i].empty()) {
-                    ics.erase(ics.begin() + i);
-                    --i;
-                }
-            }
+        const cv::Mat& mask = m_ignore_mask.get();
+        if (mask.size() == frame_cpu.size()) { ignore = mask; }
+    }
 
-            // blackout the ignored area
-            cv::fillPoly(frame_cpu, ics, cv::Scalar(0));
+    D_CPU(m_engine_bench->run(frame_pixels));
+
+    // a scene without foreground for a while is only detected at the idle rate, the frames in between are
+    // passed on with the last result. Motion in progress or lingering always keeps every frame.
+    auto run_now = std::chrono::steady_clock::now();
+    bool idle = m_detect_idle_fps > 0 && !m_motion_detect_start_set && !m_motion_detect_linger &&
+                run_now - m_detect_foreground >= std::chrono::seconds(m_detect_idle_s);
+    m_detect_ran = !idle || run_now - m_detect_last_run >= std::chrono::microseconds(1000000 / std::max(1, m_detect_idle_fps));
+    m_detect_idle = idle;
+    if (m_detect_ran) { m_detect_last_run = run_now; }
+
+    // finding motion contours, every tile on its own worker
+    update_detect_tiles(frame_cpu.size());
+    for (size_t i = 0; i < m_detect_tiles.size(); i++) {
+        bool stale = false;
+        if (i < m_focus_targets.size()) {
+            const FocusTarget& target = m_focus_targets[i];
+            stale = !target.fresh || m_detect_tiles[i].rect.empty() || (m_detect_vectors && target.frame->motion.empty());
+        }
+        else {
+            stale = m_detect_vectors && m_frame_detection->motion.empty(); // keyframes have no motion vectors
         }
+        m_detect_tiles[i].skip = !m_detect_ran || stale; // keeps its last result
+    }
+    cv::parallel_for_(cv::Range(0, static_cast<int>(m_detect_tiles.size())), [&](const cv::Range& range) {
+        D_ALLOC(uint64_t allocs_before = alloc_count());
+        bool worker = std::this_thread::get_id() != m_thread_detect_motion.get_id();
+        double cpu_start = worker ? thread_cpu_ms() : 0;
+        for (int i = range.start; i < range.end; i++) {
+            if (!m_detect_tiles[i].skip) { m_detect_tiles[i].detect(frame_cpu, ignore, draw_info); }
+        }
+        if (worker) { m_detect_workers_cpu_us += static_cast<int64_t>((thread_cpu_ms() - cpu_start) * 1000); }
+        D_ALLOC(if (worker) m_detect_allocations += alloc_count() - allocs_before);
+    });
+    for (const DetectTile& tile : m_detect_tiles) {
+        if (!tile.skip && tile.changed > 0) { m_detect_foreground = run_now; } // back to every frame
     }
 
-    // finding motion contours
-    cv::Mat fgmask;
-    m_fgbg->apply(frame_cpu, fgmask);
-
-    cv::Mat thresh;
-    cv::threshold(fgmask, thresh, 128, 255, cv::THRESH_BINARY);
-
-    std::vector<std::vector<cv::Point>> contours;
-    cv::findContours(thresh, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+    // show the ignored area blacked out where the detection frame is displayed
+    bool shown = m_enable_minimap || m_enable_minimap_fullscreen || m_focus_channel != -1;
+    if (!ignore.empty() && !frame_draw.empty() && shown) { frame_draw.setTo(cv::Scalar(0, 0, 0), ignore); }
+
+    // alarm zones, counted on the foreground of every tile each detected frame, a zone alarms on its
+    // own pixel count whether or not the largest contour makes it to motion
+    if (m_enable_alarm_pixels) {
+        const auto& zones = m_alarm_zones.get();
+        bool alarm = false;
+        for (const AlarmZone& zone : zones) {
+            if (zone.frame != frame_cpu.size()) { continue; } // rasterised for the previous focus size
+            if (!frame_draw.empty()) {
+                cv::Rect visible = zone.bounds & cv::Rect(cv::Point(), frame_draw.size());
+                if (!zone.points.empty()) { cv::polylines(frame_draw, zone.points, true, cv::Scalar(0, 0, 255), 1); }
+                else if (!visible.empty()) { frame_draw(visible).setTo(cv::Scalar(0, 0, 255), zone.mask(visible - zone.bounds.tl())); } // BGR
+            }
+            if (m_detect_ran && !alarm) { alarm = zone.count(m_detect_tiles, m_alarm_scratch) >= zone.min_pixels; }
+        }
+        if (alarm) {
+            play_unique_sound(g_sfx_8bit_clicky); // play sfx alarm if in detected area
+        }
+    }
 
     // Find largest motion area
-    std::vector<cv::Point> max_contour;
-    cv::Rect motion_region;
-    double max_area = 0;
-    m_motion_detected = false;
-
-    if ((m_enable_minimap || m_enable_minimap_fullscreen) && m_enable_info_rect)
-        cv::drawContours(frame_cpu, contours, -1, cv::Scalar(255, 0, 0), 1);
-
-    for (const auto& contour : contours) {
-        if (cv::contourArea(contour) >= m_motion_min_area) {
-            cv::Rect rect = cv::boundingRect(contour);
-            double area = rect.width * rect.height;
-            if (area >= m_motion_min_rect_area) {
-                if ((m_enable_minimap || m_enable_minimap_fullscreen) && m_enable_info_rect)
-                    cv::rectangle(frame_cpu, rect, cv::Scalar(0, 255, 0), 1);
-
-                if (area > max_area) {
-                    max_area = area;
-                    max_contour = contour;
-                    motion_region = rect;
-                    m_motion_detected = true;
-                }
+    const DetectTile* max_tile = nullptr;
+    for (const DetectTile& tile : m_detect_tiles) {
+        if (draw_info) {
+            cv::drawContours(frame_draw, tile.contours, -1, cv::Scalar(255, 0, 0), 1);
+            for (const cv::Rect& rect : tile.rects) {
+                if (draw_scaled) { m_frame_detection->rects.push_back(rect); }
+                else { cv::rectangle(frame_draw, rect, cv::Scalar(0, 255, 0), 1); }
             }
         }
+        if (tile.detected && (!max_tile || tile.max_area > max_tile->max_area)) {
+            max_tile = &tile;
+        }
     }
 
+    cv::Rect motion_region;
+    m_motion_detected = max_tile != nullptr;
+    if (max_tile) { motion_region = max_tile->motion_region; }
+
     auto now = std::chrono::high_resolution_clock::now();
     if (m_motion_detected) {
 
-        if ((m_enable_minimap || m_enable_minimap_fullscreen) && m_enable_info_rect)
-            cv::rectangle(frame_cpu, motion_region, cv::Scalar(0, 0, 255), 2);
+        if (draw_info && draw_scaled) { m_frame_detection->region = motion_region; }
+        else if (draw_info) { cv::rectangle(frame_draw, motion_region, cv::Scalar(0, 0, 255), 2); }
 
         m_motion_region.update(motion_region);
 
@@ -205,33 +287,20 @@ void MotionDetector::detect_largest_motion_area_set_channel()
         auto motion_duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_motion_detect_start).count();
         m_motion_detected_min_ms = motion_duration >= m_motion_detect_min_ms;
         if (m_motion_detected_min_ms) {
-            if (m_focus_channel == -1) {
-
-                float rel_x = motion_region.x / static_cast<float>(W_0);
-                float rel_y = motion_region.y / static_cast<float>(H_0);
-
-                int col = static_cast<int>(rel_x * 3);
-                int row = static_cast<int>(rel_y * 3);
-
-                int new_channel;
-                if (row == 0) { new_channel = 1 + col; } // first row
-                else if (row == 1) {
-                    new_channel = 4 + col;
-                } // second row
-                else {
-                    new_channel = (col == 0 ? 7 : 8);
-                } // third row
-
-                if (m_current_channel != new_channel) {
-                    change_channel(new_channel);
-                }
+            if (m_focus_channel == -1 && m_current_channel != max_tile->channel) {
+                change_channel(max_tile->channel);
             }
             m_motion_detect_linger_start = now;
             m_motion_detect_linger = true;
         }
 
-        if (m_motion_detected_min_ms && m_focus_channel != -1 && m_focus_channel_sound) {
-            play_unique_sound(g_sfx_8bit_clicky); // play sfx alarm if in detected area
+        if (m_motion_detected_min_ms) {
+            for (const DetectTile& tile : m_detect_tiles) {
+                if (tile.sound && tile.detected) {
+                    play_unique_sound(g_sfx_8bit_clicky); // play sfx alarm if in detected area
+                    break;
+                }
+            }
         }
     }
     else {
@@ -246,25 +315,265 @@ void MotionDetector::detect_largest_motion_area_set_channel()
         }
     }
 
+    LatencyTracker::get().record(m_frame_detection->channel, LATENCY_STAGE_DETECT, m_frame_detection->published, std::chrono::steady_clock::now());
+
+    m_frame_detection->generation = ++m_detection_generation;
+    m_frame_detection_mailbox.publish(m_frame_detection);
+}
+
+// detected frames per second and their CPU (detection thread and tile workers), over about a second
+void MotionDetector::update_detect_rate(double cpu_ms)
+{
+    m_detect_window_cpu_ms += cpu_ms;
+    if (m_detect_ran) { m_detect_window_runs++; }
+
+    auto now = std::chrono::steady_clock::now();
+    double elapsed_ms = std::chrono::duration<double, std::milli>(now - m_detect_window_start).count();
+    if (elapsed_ms < 1000) { return; }
+
+    m_detect_rate = m_detect_window_runs * 1000.0 / elapsed_ms;
+    m_detect_cpu_ms = m_detect_window_runs ? m_detect_window_cpu_ms / m_detect_window_runs : 0.0;
+    m_detect_cpu = m_detect_window_cpu_ms * 100.0 / elapsed_ms;
+    m_detect_window_start = now;
+    m_detect_window_runs = 0;
+    m_detect_window_cpu_ms = 0;
+}
+
+// native size of the focus channel/area, only scaled down to fit its share of the window and the -fdw width
+cv::Size MotionDetector::focus_detect_size(const cv::Size& roi, const cv::Size& cell)
+{
+    double scale = 1.0;
+    if (cell.width > 0 && cell.height > 0) {
+        scale = std::min({scale, static_cast<double>(cell.width) / roi.width, static_cast<double>(cell.height) / roi.height});
+    }
+    if (m_focus_detect_width > 0) { scale = std::min(scale, static_cast<double>(m_focus_detect_width) / roi.width); }
+    if (scale >= 1.0) { return roi; }
+    return cv::Size(std::max(1, cvRound(roi.width * scale)), std::max(1, cvRound(roi.height * scale)));
+}
+
+// a focus reader published a frame the detection thread has not taken yet
+bool MotionDetector::focus_frames_pending()
+{
+    for (const FocusTarget& target : m_focus_targets) {
+        if (m_readers[target.channel]->get_generation() != target.generation) { return true; }
+    }
+    return false;
+}
+
+bool MotionDetector::take_focus_frames()
+{
+    bool fresh = false;
+    for (FocusTarget& target : m_focus_targets) {
+        target.fresh = false;
+        FrameReader& reader = *m_readers[target.channel];
+        if (reader.get_generation() == target.generation) { continue; }
+
+        FramePtr frame = reader.get_latest_frame(true);
+        if (!frame) { continue; }
+        if (frame->generation == target.generation) {
+            m_detect_duplicate++;
+            continue;
+        }
+        if (target.generation != 0 && frame->generation > target.generation + 1) {
+            m_detect_skipped += frame->generation - target.generation - 1;
+        }
+        target.generation = frame->generation;
+        if (frame->mat.empty()) { continue; }
+
+        target.frame = frame;
+        target.fresh = true;
+        fresh = true;
+    }
+    return fresh;
+}
+
+// the targets on a grid, each at its own resolution scaled down to its share of the window,
+// a target without a frame yet takes no space
+bool MotionDetector::update_focus_layout()
+{
+    int count = static_cast<int>(m_focus_targets.size());
+    int cols = static_cast<int>(std::ceil(std::sqrt(count)));
+    int rows = (count + cols - 1) / cols;
+    cv::Size share(m_display_width / cols, m_display_height / rows);
+
+    bool changed = false;
+    cv::Size cell;
+    for (FocusTarget& target : m_focus_targets) {
+        cv::Rect roi;
+        if (target.frame) {
+            cv::Rect full(0, 0, target.frame->mat.cols, target.frame->mat.rows);
+            roi = target.area.empty() ? full : (target.area & full);
+        }
+        cv::Size size = roi.empty() ? cv::Size() : focus_detect_size(roi.size(), share);
+        changed |= roi != target.roi || size != target.rect.size();
+        target.roi = roi;
+        target.rect.width = size.width;
+        target.rect.height = size.height;
+        cell.width = std::max(cell.width, size.width);
+        cell.height = std::max(cell.height, size.height);
+    }
+
+    for (int i = 0; i < count; i++) {
+        cv::Point position((i % cols) * cell.width, (i / cols) * cell.height);
+        changed |= position != m_focus_targets[i].rect.tl();
+        m_focus_targets[i].rect.x = position.x;
+        m_focus_targets[i].rect.y = position.y;
+    }
+    m_focus_frame_size = cv::Size(cols * cell.width, rows * cell.height);
+    return changed;
+}
+
+// the targets' areas side by side, each detected on its own tile
+bool MotionDetector::prepare_focus_frame()
+{
+    if (update_focus_layout()) { m_focus_layout_changed = true; }
+    if (m_focus_frame_size.empty()) { return false; }
+
+    m_frame_detection = m_detection_pool.acquire(m_focus_frame_size.width, m_focus_frame_size.height, CV_8UC3);
+    m_frame_detection->luma.release();
+    if (m_focus_targets.size() > 1) { m_frame_detection->mat.setTo(cv::Scalar(0, 0, 0)); } // gaps between areas of different sizes
+
+    const FocusTarget* newest = nullptr;
+    for (const FocusTarget& target : m_focus_targets) {
+        if (target.rect.empty()) { continue; }
+        cv::Mat src = target.frame->mat(target.roi);
+        cv::Mat dst = m_frame_detection->mat(target.rect);
+        if (src.size() == dst.size()) { src.copyTo(dst); }
+        else { cv::resize(src, dst, dst.size(), 0, 0, cv::INTER_AREA); }
+        if (target.fresh && !newest) { newest = &target; }
+    }
+    if (newest) { m_frame_detection->copy_meta(*newest->frame); } // latency is traced for the first target with a new frame
+
+    // motion vectors of the same areas, a target without any this frame is skipped by its tile
+    if (m_detect_vectors) {
+        m_detection_pool.create(m_frame_detection->motion, m_focus_frame_size.width, m_focus_frame_size.height, CV_8UC1);
+        if (m_focus_targets.size() > 1) { m_frame_detection->motion.setTo(0); }
+        for (const FocusTarget& target : m_focus_targets) {
+            if (target.rect.empty() || target.frame->motion.empty()) { continue; }
+            expand_motion_vectors(target.frame->motion, target.roi, m_frame_detection->motion(target.rect));
+        }
+    }
+    else {
+        m_frame_detection->motion.release();
+    }
+
+    m_focus_detect_size.update(m_focus_frame_size);
+    return true;
+}
+
+// the 8 channels on the 3x3 mosaic, the last cell is empty
+static cv::Rect mosaic_rect(int channel)
+{
     constexpr int mini_ch_w = W_0 / 3;
     constexpr int mini_ch_h = H_0 / 3;
 
-    // drawing alarm pixels
-    if (m_enable_alarm_pixels && motion_region.size().width < mini_ch_w && motion_region.size().height < mini_ch_h) {
-        auto ap = m_alarm_pixels.get();
-        if (!ap.empty()) {
-            for (size_t i = 0; i < ap.size(); i++) {
-                cv::Point p = ap[i];
-                frame_cpu.at<cv::Vec3b>(p.y, p.x) = cv::Vec3b(0, 0, 255); // BGR - use frame_cpu instead of m_frame_detection
-
-                if (!max_contour.empty()) {
-                    if (cv::pointPolygonTest(max_contour, cv::Point2f(p.x, p.y), false) >= 0) {
-                        play_unique_sound(g_sfx_8bit_clicky); // play sfx alarm if in detected area
-                    }
-                }
-            }
+    int row = (channel - 1) / 3;
+    int col = (channel - 1) % 3;
+    return cv::Rect(mini_ch_w * col, mini_ch_h * row, mini_ch_w, mini_ch_h);
+}
+
+// (re)creates the tiles if the detection frame size or the focus layout changed
+void MotionDetector::update_detect_tiles(const cv::Size& size)
+{
+    bool mosaic = m_focus_targets.empty();
+    size_t count = mosaic ? CHANNEL_COUNT : m_focus_targets.size();
+    if (m_detect_tiles.size() == count && m_detect_tiles_size == size && !m_focus_layout_changed) { return; }
+    m_focus_layout_changed = false;
+
+    m_detect_tiles.clear();
+    m_detect_tiles.resize(count);
+    m_detect_tiles_size = size;
+    for (size_t i = 0; i < count; i++) {
+        DetectTile& tile = m_detect_tiles[i];
+        tile.channel = mosaic ? static_cast<int>(i) + 1 : m_focus_targets[i].channel;
+        tile.rect = mosaic ? mosaic_rect(tile.channel) : m_focus_targets[i].rect;
+        tile.sound = !mosaic && m_focus_targets[i].sound;
+        tile.engine = DetectorEngine::create(m_detect_engine_params);
+        tile.min_area = m_motion_min_area;
+        tile.min_rect_area = m_motion_min_rect_area;
+        tile.blobs = m_detect_blobs;
+    }
+    D(std::cout << "detecting on " << count << " tile(s) of " << size.width << "x" << size.height << " with " << DetectorEngine::name(m_detect_engine_params.engine) << (m_detect_blobs ? " (blobs)" : "") << std::endl);
+}
+
+// outline: the contours are only needed for the overlay, the blobs path skips tracing them otherwise
+void MotionDetector::DetectTile::detect(const cv::Mat& frame, const cv::Mat& ignore, bool outline)
+{
+    changed = engine->apply(frame(rect), mask);
+    if (!ignore.empty() && changed > 0) {
+        cv::subtract(mask, ignore(rect), mask); // foreground and not ignored
+        changed = cv::countNonZero(mask);
+    }
+
+    rects.clear(); // keeps its capacity
+    detected = false;
+    max_area = 0;
+
+    // a contour never has more area than the pixels it outlines
+    if (changed == 0 || changed < min_area) {
+        contours.clear();
+        return;
+    }
+    if (blobs) { find_blobs(outline); }
+    else { find_contours(); }
+}
+
+void MotionDetector::DetectTile::find_contours()
+{
+    // overwrites the previous contours in place, the point vectors keep their capacity
+    cv::findContours(mask, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE, rect.tl());
+    for (const std::vector<cv::Point>& contour : contours) {
+        if (cv::contourArea(contour) < min_area) { continue; }
+        add_region(cv::boundingRect(contour));
+    }
+}
+
+// one pass labelling with area and bounding box per blob, small blobs are dropped without any point list
+void MotionDetector::DetectTile::find_blobs(bool outline)
+{
+    contours.clear();
+    int count = cv::connectedComponentsWithStats(mask, labels, stats, centroids, 8, CV_32S);
+    for (int label = 1; label < count; label++) { // 0 is the background
+        if (stats.at<int>(label, cv::CC_STAT_AREA) < min_area) { continue; }
+        cv::Rect local(stats.at<int>(label, cv::CC_STAT_LEFT), stats.at<int>(label, cv::CC_STAT_TOP),
+                       stats.at<int>(label, cv::CC_STAT_WIDTH), stats.at<int>(label, cv::CC_STAT_HEIGHT));
+        size_t before = rects.size();
+        add_region(local + rect.tl());
+
+        if (outline && rects.size() != before) {
+            cv::compare(labels(local), label, blob, cv::CMP_EQ);
+            cv::findContours(blob, blob_contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE, local.tl() + rect.tl());
+            contours.insert(contours.end(), blob_contours.begin(), blob_contours.end());
         }
     }
+}
 
-    m_frame_detection_dbuff.update(m_frame_detection);
+void MotionDetector::DetectTile::add_region(const cv::Rect& bounds)
+{
+    double area = bounds.width * bounds.height;
+    if (area < min_rect_area) { return; }
+
+    rects.push_back(bounds);
+    if (area > max_area) {
+        max_area = area;
+        motion_region = bounds;
+        detected = true;
+    }
+}
+
+int MotionDetector::AlarmZone::count(const std::vector<DetectTile>& tiles, cv::Mat& scratch) const
+{
+    int pixels = 0;
+    for (const DetectTile& tile : tiles) {
+        cv::Rect overlap = bounds & tile.rect;
+        if (overlap.empty() || tile.changed == 0 || tile.mask.empty()) { continue; }
+
+        if (scratch.cols < overlap.width || scratch.rows < overlap.height) {
+            scratch.create(std::max(scratch.rows, overlap.height), std::max(scratch.cols, overlap.width), CV_8UC1);
+        }
+        cv::Mat both = scratch(cv::Rect(cv::Point(), overlap.size()));
+        cv::bitwise_and(tile.mask(overlap - tile.rect.tl()), mask(overlap - bounds.tl()), both);
+        pixels += cv::countNonZero(both);
+    }
+    return pixels;
 }
@@ -1,5 +1,6 @@
 #include "motion_detector_params.hpp"
 #include "debug.hpp"
+#include "detector_engine.hpp"
 #include "globals.hpp"
 #include "utils.hpp"
 
@@ -8,6 +9,11 @@ MotionDetectorParams::MotionDetectorParams(std::unique_ptr<argparse::ArgumentPar
     ip                         {program->get<std::string>("ip")},
     username                   {program->get<std::string>("username")},
     password                   {program->get<std::string>("password")},
+    input                      {program->get<std::string>("input")},
+    input_realtime             {program->get<int>("input_realtime")},
+    decode_workers             {program->get<int>("decode_workers")},
+    decode_threads             {program->get<int>("decode_threads")},
+    stream_cache               {program->get<std::string>("stream_cache")},
     subtype                    {program->get<int>("subtype")},
     width                      {program->get<int>("width")},
     height                     {program->get<int>("height")},
@@ -19,11 +25,17 @@ MotionDetectorParams::MotionDetectorParams(std::unique_ptr<argparse::ArgumentPar
     current_channel            {program->get<int>("current_channel")},
     enable_motion              {program->get<int>("enable_motion")},
     enable_motion_zoom_largest {program->get<int>("enable_motion_zoom_largest")},
+    detect_engine              {DetectorEngine::parse(program->get<std::string>("detect_engine"))},
+    detect_history             {program->get<int>("detect_history")},
+    detect_threshold           {program->get<double>("detect_threshold")},
+    detect_idle_fps            {program->get<int>("detect_idle_fps")},
+    detect_idle_s              {program->get<int>("detect_idle_s")},
+    detect_blobs               {program->get<int>("detect_blobs")},
     sleep_ms_draw              {program->get<int>("sleep_ms_draw")},
-    sleep_ms_motion            {program->get<int>("sleep_ms_motion")},
     enable_tour                {program->get<int>("enable_tour")},
     tour_ms                    {program->get<int>("tour_ms")},
     enable_info                {program->get<int>("enable_info")},
+    latency_report             {program->get<int>("latency_report")},
     enable_info_line           {program->get<int>("enable_info_line")},
     enable_info_rect           {program->get<int>("enable_info_rect")},
     enable_minimap             {program->get<int>("enable_minimap")},
@@ -35,15 +47,30 @@ MotionDetectorParams::MotionDetectorParams(std::unique_ptr<argparse::ArgumentPar
     ignore_contours_file       {program->get<std::string>("ignore_contours_file")},
     alarm_pixels               {program->get<std::string>("alarm_pixels")},
     alarm_pixels_file          {program->get<std::string>("alarm_pixels_file")},
+    alarm_zones                {program->get<std::string>("alarm_zones")},
+    alarm_zones_file           {program->get<std::string>("alarm_zones_file")},
+    alarm_zone_min             {program->get<int>("alarm_zone_min")},
     focus_channel              {program->get<int>("focus_channel")},
     focus_channel_area         {program->get<std::string>("focus_channel_area")},
     focus_channel_sound        {program->get<int>("focus_channel_sound")},
+    focus_targets              {program->get<std::string>("focus_targets")},
+    focus_detect_width         {program->get<int>("focus_detect_width")},
     low_cpu                    {program->get<int>("low_cpu")},
     low_cpu_hq_motion          {program->get<int>("low_cpu_hq_motion")},
     low_cpu_hq_motion_dual     {program->get<int>("low_cpu_hq_motion_dual")}
 // clang-format on
 {
 
+    if ((input.empty() || input == "dahua") && (ip.empty() || username.empty() || password.empty())) {
+        std::cerr << "Error: --ip, --username and --password are required with dahua input" << std::endl;
+        std::exit(1);
+    }
+
+    if (detect_engine == -1) {
+        std::cerr << "Error: unknown --detect_engine " << program->get<std::string>("detect_engine") << " (knn, mog2, cnt, diff, ewma, mv)" << std::endl;
+        std::exit(1);
+    }
+
     if (program->get<bool>("ignore_alarm_make")) {
         width = W_0;
         height = H_0;
@@ -75,12 +102,16 @@ MotionDetectorParams::MotionDetectorParams(std::unique_ptr<argparse::ArgumentPar
     }
 
     if (sleep_ms_draw == -1) { sleep_ms_draw = 10; sleep_ms_draw_auto = true; }
-    if (sleep_ms_motion == -1) { sleep_ms_motion = 10; sleep_ms_motion_auto = true; }
 
     // clang-format off
     D(std::cout << "ip                        = " << ip                         << std::endl);
     D(std::cout << "username                  = " << username                   << std::endl);
     D(std::cout << "password                  = " << password                   << std::endl);
+    D(std::cout << "input                     = " << input                      << std::endl);
+    D(std::cout << "input_realtime            = " << input_realtime             << std::endl);
+    D(std::cout << "decode_workers            = " << decode_workers             << std::endl);
+    D(std::cout << "decode_threads            = " << decode_threads             << std::endl);
+    D(std::cout << "stream_cache              = " << stream_cache               << std::endl);
     D(std::cout << "width                     = " << width                      << std::endl);
     D(std::cout << "height                    = " << height                     << std::endl);
     D(std::cout << "fullscreen                = " << fullscreen                 << std::endl);
@@ -91,11 +122,17 @@ MotionDetectorParams::MotionDetectorParams(std::unique_ptr<argparse::ArgumentPar
     D(std::cout << "current_channel           = " << current_channel            << std::endl);
     D(std::cout << "enable_motion             = " << enable_motion              << std::endl);
     D(std::cout << "enable_motion_zoom_larges = " << enable_motion_zoom_largest << std::endl);
+    D(std::cout << "detect_engine             = " << DetectorEngine::name(detect_engine) << std::endl);
+    D(std::cout << "detect_history            = " << detect_history             << std::endl);
+    D(std::cout << "detect_threshold          = " << detect_threshold           << std::endl);
+    D(std::cout << "detect_idle_fps           = " << detect_idle_fps            << std::endl);
+    D(std::cout << "detect_idle_s             = " << detect_idle_s              << std::endl);
+    D(std::cout << "detect_blobs              = " << detect_blobs               << std::endl);
     D(std::cout << "enable_tour               = " << enable_tour                << std::endl);
     D(std::cout << "sleep_ms_draw             = " << sleep_ms_draw              << " (auto: " << sleep_ms_draw_auto << ")" << std::endl);
-    D(std::cout << "sleep_ms_motion           = " << sleep_ms_motion            << " (auto: " << sleep_ms_motion_auto << ")" << std::endl);
     D(std::cout << "tour_ms                   = " << tour_ms                    << std::endl);
     D(std::cout << "enable_info               = " << enable_info                << std::endl);
+    D(std::cout << "latency_report            = " << latency_report             << std::endl);
     D(std::cout << "enable_info_line          = " << enable_info_line           << std::endl);
     D(std::cout << "enable_info_rect          = " << enable_info_rect           << std::endl);
     D(std::cout << "enable_minimap            = " << enable_minimap             << std::endl);
@@ -107,9 +144,14 @@ MotionDetectorParams::MotionDetectorParams(std::unique_ptr<argparse::ArgumentPar
     D(std::cout << "ignore_contours_file      = " << ignore_contours_file       << std::endl);
     D(std::cout << "alarm_pixels              = " << alarm_pixels               << std::endl);
     D(std::cout << "alarm_pixels_file         = " << alarm_pixels_file          << std::endl);
+    D(std::cout << "alarm_zones               = " << alarm_zones                << std::endl);
+    D(std::cout << "alarm_zones_file          = " << alarm_zones_file           << std::endl);
+    D(std::cout << "alarm_zone_min            = " << alarm_zone_min             << std::endl);
     D(std::cout << "focus_channel             = " << focus_channel              << std::endl);
     D(std::cout << "focus_channel_area        = " << focus_channel_area         << std::endl);
     D(std::cout << "focus_channel_sound       = " << focus_channel_sound        << std::endl);
+    D(std::cout << "focus_targets             = " << focus_targets              << std::endl);
+    D(std::cout << "focus_detect_width        = " << focus_detect_width         << std::endl);
     D(std::cout << "low_cpu                   = " << low_cpu                    << std::endl);
     D(std::cout << "low_cpu_hq_motion         = " << low_cpu_hq_motion          << std::endl);
     D(std::cout << "low_cpu_hq_motion_dual    = " << low_cpu_hq_motion_dual     << std::endl);
@@ -7,6 +7,11 @@ struct MotionDetectorParams {
     std::string ip;
     std::string username;
     std::string password;
+    std::string input;
+    int input_realtime;
+    int decode_workers;
+    int decode_threads;
+    std::string stream_cache;
     int subtype;
     int width;
     int height;
@@ -18,13 +23,18 @@ struct MotionDetectorParams {
     int current_channel;
     int enable_motion;
     int enable_motion_zoom_largest;
+    int detect_engine;
+    int detect_history;
+    double detect_threshold;
+    int detect_idle_fps;
+    int detect_idle_s;
+    int detect_blobs;
     int sleep_ms_draw;
     bool sleep_ms_draw_auto;
-    int sleep_ms_motion;
-    bool sleep_ms_motion_auto;
     int enable_tour;
     int tour_ms;
     int enable_info;
+    int latency_report;
     int enable_info_line;
     int enable_info_rect;
     int enable_minimap;
@@ -36,9 +46,14 @@ struct MotionDetectorParams {
     std::string ignore_contours_file;
     std::string alarm_pixels;
     std::string alarm_pixels_file;
+    std::string alarm_zones;
+    std::string alarm_zones_file;
+    int alarm_zone_min;
     int focus_channel;
     std::string focus_channel_area;
     int focus_channel_sound;
+    std::string focus_targets;
+    int focus_detect_width;
     int low_cpu;
     int low_cpu_hq_motion;
     int low_cpu_hq_motion_dual;
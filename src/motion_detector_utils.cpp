@@ -1,27 +1,37 @@
 #include "motion_detector.hpp"
+#include <algorithm>
 #include <fstream>
 
-cv::UMat MotionDetector::get_frame(int channel, int layout_changed)
+// returned mat points into a pooled frame, it is only valid while `hold` is alive
+cv::Mat MotionDetector::get_frame(int channel, int layout_changed, FramePtr& hold)
 {
     if (m_low_cpu) {
-        if (m_low_cpu_hq_motion && m_readers[channel]->is_running() && m_readers[channel]->is_active()) {
-            return m_readers[channel]->get_latest_frame(layout_changed);
+        // HD only while the channel decodes and past the frame it was paused on, the mosaic until then
+        FrameReader& reader = *m_readers[channel];
+        bool hq = reader.get_decode_level() != DECODE_LEVEL_PAUSED && reader.get_generation() > m_hq_paused_generation[channel];
+        if (m_low_cpu_hq_motion && reader.is_running() && reader.is_active() && hq) {
+            hold = m_readers[channel]->get_latest_frame(layout_changed);
+            mark_drawn(hold);
+            return hold ? hold->mat : cv::Mat();
         }
 
         // get frame fro ch 0
         constexpr int mini_ch_w = W_0 / 3;
         constexpr int mini_ch_h = H_0 / 3;
 
-        cv::UMat frame0 = m_frame0_dbuff.get();
-        if (frame0.empty()) { return frame0; }
+        hold = m_readers[0]->get_latest_frame(true);
+        if (!hold || hold->mat.cols != W_0 || hold->mat.rows != H_0) { return cv::Mat(); }
+        mark_drawn(hold);
 
         int row = (channel - 1) / 3; // groups of 3 channels
         if (channel >= 7) row = 2;   // adjust since only 2 channels in last row
         int col = (channel - 1) % 3; // column index
-        return frame0(cv::Rect(mini_ch_w * col, mini_ch_h * row, mini_ch_w, mini_ch_h));
+        return hold->mat(cv::Rect(mini_ch_w * col, mini_ch_h * row, mini_ch_w, mini_ch_h));
     }
 
-    return m_readers[channel]->get_latest_frame(layout_changed);
+    hold = m_readers[channel]->get_latest_frame(layout_changed);
+    mark_drawn(hold);
+    return hold ? hold->mat : cv::Mat();
 }
 
 void MotionDetector::change_channel(int ch)
@@ -33,24 +43,54 @@ void MotionDetector::change_channel(int ch)
     m_previous_channel = prev;
     m_current_channel = ch;
 
-    if (m_low_cpu_hq_motion) {
-        if (!m_readers[ch]->is_running()) {
-            for (int i = 1; i <= CHANNEL_COUNT; i++) {
-                if (i == ch) {
-                    m_readers[i]->start();
-                }
-                else {
-                    if (m_low_cpu_hq_motion_dual) {
-                        if (i != prev) {
-                            m_readers[i]->stop();
-                        }
-                    }
-                    else {
-                        m_readers[i]->stop();
-                    }
-                }
-            }
+    // the sessions stay open, update_decode_levels() resumes decoding at the next keyframe
+    if (m_low_cpu_hq_motion && m_readers[ch]->get_decode_level() == DECODE_LEVEL_PAUSED) {
+        m_hq_paused_generation[ch] = m_readers[ch]->get_generation();
+    }
+}
+
+// channel 0 is detected on its luma plane, BGR only if the mosaic is on screen
+void MotionDetector::update_reader_outputs()
+{
+    if (m_focus_channel != -1) { return; }
+    m_readers[0]->set_luma(true);
+    m_readers[0]->set_bgr(m_low_cpu || m_enable_minimap || m_enable_minimap_fullscreen);
+}
+
+// channels that are not on screen only decode what they need to come back quickly
+void MotionDetector::update_decode_levels()
+{
+    bool single = m_enable_fullscreen_channel || (m_display_mode == DISPLAY_MODE_SINGLE);
+    bool zoom = m_enable_motion && m_enable_motion_zoom_largest && (m_motion_detected_min_ms || m_motion_detect_linger);
+
+    // codec threads go to what is detected on and what is displayed large
+    for (int ch = 0; ch <= CHANNEL_COUNT; ch++) {
+        bool large = (single || zoom) && ch == m_current_channel && !m_enable_minimap_fullscreen;
+        bool hidden = m_enable_minimap_fullscreen || ((single || zoom) && ch != m_current_channel);
+        DECODE_PRIORITY priority = DECODE_PRIORITY_NORMAL;
+        bool detected = ch == m_detect_channel || std::any_of(m_focus_targets.begin(), m_focus_targets.end(), [&](const FocusTarget& t) { return t.channel == ch; });
+        if (detected || large) { priority = DECODE_PRIORITY_HIGH; }
+        else if (hidden) { priority = DECODE_PRIORITY_LOW; }
+        m_readers[ch]->set_decode_priority(priority);
+    }
+
+    if (m_focus_channel != -1) { return; } // focus mode starts/stops readers instead
+
+    // low_cpu_hq: every HD session is open, only the current channel (and the previous one with dual) decodes
+    if (m_low_cpu) {
+        for (int ch = 1; ch <= CHANNEL_COUNT && m_low_cpu_hq_motion; ch++) {
+            bool shown = ch == m_current_channel || (m_low_cpu_hq_motion_dual && ch == m_previous_channel);
+            m_readers[ch]->set_decode_level(shown ? DECODE_LEVEL_FULL : DECODE_LEVEL_PAUSED);
         }
+        return;
+    }
+
+    for (int ch = 1; ch <= CHANNEL_COUNT; ch++) {
+        DECODE_LEVEL level = DECODE_LEVEL_FULL;
+        if (m_enable_minimap_fullscreen) { level = DECODE_LEVEL_NONKEY; }            // only channel 0 on screen
+        else if (single && ch != m_current_channel) { level = DECODE_LEVEL_NONKEY; } // hidden until the layout changes
+        else if (zoom && ch != m_current_channel) { level = DECODE_LEVEL_NONREF; }   // back on screen when the zoom ends
+        m_readers[ch]->set_decode_level(level);
     }
 }
 
@@ -107,6 +147,33 @@ std::tuple<long, long, long, long> MotionDetector::parse_area(const std::string&
     return std::make_tuple(x, y, w, h);
 }
 
+// e.g. "3:100x200 320x240:1,6" (channel, optional area, optional sound)
+void MotionDetector::parse_focus_targets(const std::string& input)
+{
+    std::stringstream ss(input);
+    std::string targetStr;
+
+    while (std::getline(ss, targetStr, SPLIT_LIST)) { // Split targets by ","
+        std::stringstream fieldStream(targetStr);
+        std::string channelStr, areaStr, soundStr;
+        std::getline(fieldStream, channelStr, SPLIT_FIELD);
+        std::getline(fieldStream, areaStr, SPLIT_FIELD);
+        std::getline(fieldStream, soundStr, SPLIT_FIELD);
+        if (channelStr.empty()) { continue; }
+
+        FocusTarget target{std::stoi(channelStr), cv::Rect(), !soundStr.empty() && std::stoi(soundStr) != 0};
+        if (target.channel < 1 || target.channel > CHANNEL_COUNT) {
+            std::cerr << "Error: focus target channel " << target.channel << " is not 1-" << CHANNEL_COUNT << std::endl;
+            continue;
+        }
+        if (!areaStr.empty()) {
+            auto [x, y, w, h] = parse_area(areaStr);
+            target.area = cv::Rect(x, y, w, h);
+        }
+        m_focus_targets.push_back(target);
+    }
+}
+
 // e.g. "100x200 150x250 ...,300x400 350x450 ...";
 void MotionDetector::parse_ignore_contours(const std::string& input)
 {
@@ -134,7 +201,7 @@ void MotionDetector::parse_ignore_contours(const std::string& input)
         }
     }
 
-    m_ignore_contours.update(contours);
+    m_ignore_contours = std::move(contours);
 }
 
 void MotionDetector::parse_ignore_contours_file(const std::string& filename)
@@ -169,12 +236,72 @@ void MotionDetector::parse_ignore_contours_file(const std::string& filename)
     }
 
     file.close();
-    m_ignore_contours.update(contours);
+    m_ignore_contours = std::move(contours);
+}
+
+// the ignore area and alarm zones are made on the mosaic, or in window coordinates in focus mode,
+// focus frames are detected at their own size (see focus_detect_size)
+cv::Size MotionDetector::rasterise_size()
+{
+    if (m_focus_channel == -1) { return cv::Size(W_0, H_0); }
+    cv::Size size = m_focus_detect_size.get();
+    return size.empty() ? cv::Size(m_display_width, m_display_height) : size;
+}
+
+static std::vector<cv::Point> scale_points(const std::vector<cv::Point>& points, double sx, double sy)
+{
+    std::vector<cv::Point> scaled;
+    scaled.reserve(points.size());
+    for (const cv::Point& p : points) {
+        scaled.push_back(cv::Point(cvRound(p.x * sx), cvRound(p.y * sy)));
+    }
+    return scaled;
+}
+
+// from the coordinates the points were made in to the detection frame
+static void rasterise_scale(const cv::Size& size, int focus_channel, int display_width, int display_height, double& sx, double& sy)
+{
+    sx = sy = 1.0;
+    if (focus_channel != -1 && display_width > 0 && display_height > 0) {
+        sx = static_cast<double>(size.width) / display_width;
+        sy = static_cast<double>(size.height) / display_height;
+    }
+}
+
+// rasterised once per change, detection then only masks the foreground with it
+void MotionDetector::update_ignore_mask()
+{
+    cv::Size size = rasterise_size();
+    m_rasterised_size = size;
+
+    const auto& ics = m_ignore_contours;
+    const auto& ic = m_ignore_contour;
+    if (ics.empty() && ic.empty()) {
+        m_ignore_mask.update(cv::Mat());
+        return;
+    }
+
+    double sx, sy;
+    rasterise_scale(size, m_focus_channel, m_display_width, m_display_height, sx, sy);
+
+    cv::Mat mask(size, CV_8UC1, cv::Scalar(0)); // new buffer, the previous one may still be in use
+    if (!ics.empty()) {
+        std::vector<std::vector<cv::Point>> polys;
+        for (const auto& contour : ics) { polys.push_back(scale_points(contour, sx, sy)); }
+        cv::fillPoly(mask, polys, cv::Scalar(255));
+    }
+    if (!ic.empty()) {
+        std::vector<cv::Point> scaled = scale_points(ic, sx, sy);
+        const cv::Point* points = scaled.data();
+        int count = static_cast<int>(scaled.size());
+        cv::polylines(mask, &points, &count, 1, false, cv::Scalar(255)); // contour being made
+    }
+    m_ignore_mask.update(mask);
 }
 
 void MotionDetector::print_ignore_contours()
 {
-    auto ignore_contours = m_ignore_contours.get();
+    const auto& ignore_contours = m_ignore_contours;
     std::cout << "-ic \"";
     for (size_t i = 0; i < ignore_contours.size(); i++) {
         for (size_t x = 0; x < ignore_contours[i].size(); x++) {
@@ -202,7 +329,7 @@ void MotionDetector::parse_alarm_pixels(const std::string& input)
         }
     }
 
-    m_alarm_pixels.update(pixels);
+    m_alarm_pixels = std::move(pixels);
 }
 
 void MotionDetector::parse_alarm_pixels_file(const std::string& filename)
@@ -227,12 +354,104 @@ void MotionDetector::parse_alarm_pixels_file(const std::string& filename)
 
     file.close();
 
-    m_alarm_pixels.update(pixels);
+    m_alarm_pixels = std::move(pixels);
+}
+
+// e.g. "20:100x200 150x250 ...,300x400 350x450 ...", zones without a minimum use m_alarm_zone_min
+void MotionDetector::parse_alarm_zones(const std::string& input)
+{
+    std::stringstream ss(input);
+    std::string zoneStr;
+    while (std::getline(ss, zoneStr, SPLIT_LIST)) { // Split zones by ","
+        parse_alarm_zone(zoneStr);
+    }
+}
+
+void MotionDetector::parse_alarm_zones_file(const std::string& filename)
+{
+    std::ifstream file(filename);
+    std::string zoneStr;
+
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return;
+    }
+
+    while (std::getline(file, zoneStr)) { // Read zones line by line
+        parse_alarm_zone(zoneStr);
+    }
+
+    file.close();
+}
+
+void MotionDetector::parse_alarm_zone(const std::string& zone)
+{
+    AlarmPolygon polygon{m_alarm_zone_min, {}};
+    std::string points = zone;
+    size_t minPos = zone.find(SPLIT_MIN);
+    if (minPos != std::string::npos) {
+        polygon.min_pixels = std::max(1, std::stoi(zone.substr(0, minPos)));
+        points = zone.substr(minPos + 1);
+    }
+
+    std::stringstream pointStream(points);
+    std::string pointStr;
+    while (std::getline(pointStream, pointStr, SPLIT_POINT)) { // Split points by " "
+        size_t xPos = pointStr.find(SPLIT_COORD);              // Find 'x' separator
+        if (xPos != std::string::npos) {
+            int x = std::stoi(pointStr.substr(0, xPos));
+            int y = std::stoi(pointStr.substr(xPos + 1));
+            polygon.points.push_back(cv::Point(x, y));
+        }
+    }
+
+    if (!polygon.points.empty()) {
+        m_alarm_polygons.push_back(polygon);
+    }
+}
+
+// rasterised once per change, detection then only counts foreground pixels under the masks,
+// the cost does not depend on how many points a zone has
+void MotionDetector::update_alarm_zones()
+{
+    std::vector<AlarmZone> zones; // new buffers, the previous ones may still be in use
+    cv::Size size = rasterise_size();
+    m_rasterised_size = size;
+    double sx, sy;
+    rasterise_scale(size, m_focus_channel, m_display_width, m_display_height, sx, sy);
+
+    for (const AlarmPolygon& polygon : m_alarm_polygons) {
+        AlarmZone zone;
+        zone.frame = size;
+        zone.points = scale_points(polygon.points, sx, sy);
+        zone.bounds = cv::boundingRect(zone.points);
+        zone.mask = cv::Mat(zone.bounds.size(), CV_8UC1, cv::Scalar(0));
+        zone.min_pixels = polygon.min_pixels;
+        std::vector<std::vector<cv::Point>> polys{zone.points};
+        cv::fillPoly(zone.mask, polys, cv::Scalar(255), cv::LINE_8, 0, -zone.bounds.tl());
+        zones.push_back(std::move(zone));
+    }
+
+    const auto& aps = m_alarm_pixels;
+    if (!aps.empty()) {
+        std::vector<cv::Point> scaled = scale_points(aps, sx, sy);
+        AlarmZone zone;
+        zone.frame = size;
+        zone.bounds = cv::boundingRect(scaled);
+        zone.mask = cv::Mat(zone.bounds.size(), CV_8UC1, cv::Scalar(0));
+        zone.min_pixels = m_alarm_zone_min;
+        for (const cv::Point& p : scaled) {
+            zone.mask.at<uchar>(p - zone.bounds.tl()) = 255;
+        }
+        zones.push_back(std::move(zone));
+    }
+
+    m_alarm_zones.update(zones);
 }
 
 void MotionDetector::print_alarm_pixels()
 {
-    auto aps = m_alarm_pixels.get();
+    const auto& aps = m_alarm_pixels;
     std::cout << "-ap \"";
     for (size_t i = 0; i < aps.size(); i++) {
         std::cout << aps[i].x << SPLIT_COORD << aps[i].y;
@@ -0,0 +1,122 @@
+#include "stream_cache.hpp"
+#include "debug.hpp"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// FNV-1a, stable across runs and builds
+static uint64_t url_key(const std::string& url)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : url) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static std::string to_hex(const std::vector<uint8_t>& data)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(data.size() * 2);
+    for (uint8_t b : data) {
+        hex += digits[b >> 4];
+        hex += digits[b & 0x0f];
+    }
+    return hex;
+}
+
+static bool from_hex(const std::string& hex, std::vector<uint8_t>& data)
+{
+    if (hex == "-") { return true; } // no extradata
+    if (hex.size() % 2) { return false; }
+    data.resize(hex.size() / 2);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<uint8_t>(std::stoi(hex.substr(i * 2, 2), nullptr, 16));
+    }
+    return true;
+}
+
+StreamCache& StreamCache::get()
+{
+    static StreamCache cache;
+    return cache;
+}
+
+// one stream per line: <key> <codec id> <width> <height> <pixel format> <extradata hex or ->
+void StreamCache::open(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_path = path;
+    m_streams.clear();
+    if (m_path.empty()) { return; }
+
+    std::ifstream file(m_path);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        std::string key, hex;
+        StreamParams params;
+        if (!(iss >> key >> params.codec_id >> params.width >> params.height >> params.format >> hex)) { continue; }
+        try {
+            if (!from_hex(hex, params.extradata)) { continue; }
+            m_streams[std::stoull(key, nullptr, 16)] = std::move(params);
+        }
+        catch (const std::exception&) {
+            continue; // corrupt line, the stream gets probed again
+        }
+    }
+
+    D(std::cout << "stream cache: " << m_streams.size() << " streams from " << m_path << std::endl);
+}
+
+bool StreamCache::enabled()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return !m_path.empty();
+}
+
+bool StreamCache::lookup(const std::string& url, StreamParams& params)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    auto it = m_streams.find(url_key(url));
+    if (it == m_streams.end()) { return false; }
+    params = it->second;
+    return true;
+}
+
+void StreamCache::store(const std::string& url, const StreamParams& params)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_path.empty()) { return; }
+
+    StreamParams& cached = m_streams[url_key(url)];
+    if (cached.codec_id == params.codec_id && cached.width == params.width && cached.height == params.height &&
+        cached.format == params.format && cached.extradata == params.extradata) {
+        return;
+    }
+    cached = params;
+    save();
+}
+
+// write a temporary file and rename it, a crash never leaves half a cache behind
+void StreamCache::save()
+{
+    std::string tmp = m_path + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::trunc);
+        if (!file) {
+            std::cerr << "Failed to write stream cache " << tmp << std::endl;
+            return;
+        }
+        for (const auto& [key, params] : m_streams) {
+            file << std::hex << key << std::dec << " " << params.codec_id << " " << params.width << " " << params.height
+                 << " " << params.format << " " << (params.extradata.empty() ? "-" : to_hex(params.extradata)) << "\n";
+        }
+    }
+    if (std::rename(tmp.c_str(), m_path.c_str()) != 0) {
+        std::cerr << "Failed to write stream cache " << m_path << std::endl;
+    }
+}
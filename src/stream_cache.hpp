@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// What the decoder needs to start without probing the stream first
+struct StreamParams {
+    int codec_id{0}; // AVCodecID
+    int width{0};
+    int height{0};
+    int format{-1};                 // AVPixelFormat
+    std::vector<uint8_t> extradata; // SPS/PPS (or VPS/SPS/PPS)
+};
+
+// Codec parameters of every stream seen before, persisted in a small text file.
+// Streams are keyed by a hash of their url, credentials are never written.
+// Shared by all FrameReaders, an empty path disables the cache.
+class StreamCache {
+  public:
+    static StreamCache& get();
+
+    void open(const std::string& path);
+    bool enabled();
+    bool lookup(const std::string& url, StreamParams& params);
+    void store(const std::string& url, const StreamParams& params); // rewrites the file if anything changed
+
+  private:
+    StreamCache() = default;
+    void save();
+
+  private:
+    std::mutex m_mtx;
+    std::string m_path;
+    std::map<uint64_t, StreamParams> m_streams;
+};